@@ -0,0 +1,345 @@
+#ifndef TETRIS_AI_H
+#define TETRIS_AI_H
+
+// Beam-search player. Each ply places one known piece: the current piece,
+// then the preview pieces in order. Every placement PlacementFinder::findLocks
+// returns becomes a candidate board; the best beamWidth candidates by accumulated
+// line reward plus board evaluation go on to the next ply. The root
+// placement of the best candidate at the last ply is the move.
+//
+// Boards are Zobrist-hashed. A transposition table keyed by the hash caches
+// board evaluations across plies and searches, and merges candidates that
+// reach the same board in one ply through different placement orders.
+
+#include "tetrisPlacement.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct ZobristTable {
+    uint64_t empty;
+    uint64_t cells[GRID_HEIGHT][GRID_WIDTH];
+
+    // splitmix64, so the keys are fixed at compile time.
+    constexpr ZobristTable() : empty(0), cells() {
+        uint64_t state = 0x5EED5EED5EED5EEDull;
+        empty = next(state);
+        for (int y = 0; y < GRID_HEIGHT; y++) {
+            for (int x = 0; x < GRID_WIDTH; x++) {
+                cells[y][x] = next(state);
+            }
+        }
+    }
+
+    static constexpr uint64_t next(uint64_t& state) {
+        state += 0x9E3779B97F4A7C15ull;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+constexpr ZobristTable ZOBRIST;
+
+inline uint64_t hashBoard(const Bitboard& board) {
+    uint64_t hash = ZOBRIST.empty;
+    for (int y = 0; y < GRID_HEIGHT; y++) {
+        uint32_t row = board.getRow(y) >> BOARD_WALL;
+        while (row) {
+            hash ^= ZOBRIST.cells[y][lowestSetBit(row)];
+            row &= row - 1;
+        }
+    }
+    return hash;
+}
+
+// The hash change from locking piece without clearing any line.
+inline uint64_t hashPiece(const Tetromino& piece) {
+    uint64_t hash = 0;
+    for (const CellOffset& cell : piece.shape().cells) {
+        if (piece.y + cell.y >= 0) hash ^= ZOBRIST.cells[piece.y + cell.y][piece.x + cell.x];
+    }
+    return hash;
+}
+
+struct BoardFeatures {
+    int aggregateHeight;
+    int maxHeight;
+    int holes;
+    int bumpiness;
+};
+
+// Read off the board's surface, which it keeps current as pieces lock.
+inline BoardFeatures measureBoard(const Bitboard& board) {
+    const uint8_t* heights = board.getHeights();
+
+    BoardFeatures features = {0, 0, board.holeCount(), 0};
+    int previousHeight = 0;
+    for (int x = 0; x < GRID_WIDTH; x++) {
+        int height = heights[x];
+        features.aggregateHeight += height;
+        if (height > features.maxHeight) features.maxHeight = height;
+        if (x > 0) features.bumpiness += height > previousHeight ? height - previousHeight : previousHeight - height;
+        previousHeight = height;
+    }
+    return features;
+}
+
+// Defaults are the weights from Yiyuan Lee's hand-tuned four-feature player.
+struct EvalWeights {
+    double height = -0.510066;
+    double maxHeight = 0.0;
+    double holes = -0.35663;
+    double bumpiness = -0.184483;
+    double lines = 0.760666;
+};
+
+typedef double (*BoardEvaluator)(const BoardFeatures& features, const EvalWeights& weights);
+
+inline double linearEvaluation(const BoardFeatures& features, const EvalWeights& weights) {
+    return weights.height * features.aggregateHeight +
+           weights.maxHeight * features.maxHeight +
+           weights.holes * features.holes +
+           weights.bumpiness * features.bumpiness;
+}
+
+struct AIConfig {
+    int beamWidth = 8;
+    // Plies to search, capped at the current piece plus the known preview.
+    int depth = 2;
+};
+
+struct AIStats {
+    long long searches = 0;
+    long long nodes = 0;
+    long long tableProbes = 0;
+    long long tableHits = 0;
+    long long duplicates = 0;
+    double seconds = 0.0;
+
+    // Combines the stats of several players; seconds add up, so
+    // nodesPerSecond() stays a per-thread rate.
+    void add(const AIStats& other) {
+        searches += other.searches;
+        nodes += other.nodes;
+        tableProbes += other.tableProbes;
+        tableHits += other.tableHits;
+        duplicates += other.duplicates;
+        seconds += other.seconds;
+    }
+
+    double nodesPerSecond() const {
+        return seconds > 0 ? nodes / seconds : 0.0;
+    }
+
+    // Fraction of probes whose board was already in the table.
+    double hitRate() const {
+        return tableProbes ? (double)tableHits / tableProbes : 0.0;
+    }
+
+    // Fraction of probes that were a board already reached in the same ply.
+    double duplicateRate() const {
+        return tableProbes ? (double)duplicates / tableProbes : 0.0;
+    }
+};
+
+class TetrisAI {
+private:
+    struct BeamNode {
+        Bitboard board;
+        uint64_t hash;
+        double reward;
+        double value;
+        Tetromino root;
+    };
+
+    struct TableEntry {
+        uint64_t key;
+        uint32_t stamp;
+        int32_t candidate;
+        double eval;
+    };
+
+    AIConfig config;
+    EvalWeights weights;
+    BoardEvaluator evaluator;
+    AIStats stats;
+
+    PlacementFinder finder;
+    std::vector<TableEntry> table;
+    int tableBits;
+    uint64_t tableMask;
+    // Bumped once per ply; an entry stamped with the current ply is a
+    // candidate in it.
+    uint32_t stamp;
+
+    std::vector<BeamNode> beam;
+    std::vector<BeamNode> candidates;
+
+    static bool higherValue(const BeamNode& a, const BeamNode& b) {
+        return a.value > b.value;
+    }
+
+    void expand(const BeamNode& node, const Tetromino& piece, bool rootPly) {
+        int count = finder.findLocks(node.board, piece);
+        for (int i = 0; i < count; i++) {
+            const Tetromino& placed = finder.get(i).piece;
+            // Cells locked above the field are lost and the game is as good
+            // as over, but the board would look lower to the evaluator.
+            if (placed.y + placed.shape().minY < 0) continue;
+
+            BeamNode child;
+            child.board = node.board;
+            child.board.placeRows(placed.shape().rows, placed.x, placed.y);
+            int cleared = child.board.clearFullRows();
+            child.hash = cleared ? hashBoard(child.board) : node.hash ^ hashPiece(placed);
+            child.reward = node.reward + weights.lines * cleared;
+            child.root = rootPly ? placed : node.root;
+            stats.nodes++;
+
+            TableEntry& entry = table[child.hash & tableMask];
+            stats.tableProbes++;
+            if (entry.key == child.hash) {
+                stats.tableHits++;
+                if (entry.stamp == stamp) {
+                    stats.duplicates++;
+                    BeamNode& other = candidates[entry.candidate];
+                    if (child.reward > other.reward) {
+                        other.value += child.reward - other.reward;
+                        other.reward = child.reward;
+                        other.root = child.root;
+                    }
+                    continue;
+                }
+            } else {
+                entry.key = child.hash;
+                entry.eval = evaluator(measureBoard(child.board), weights);
+            }
+            entry.stamp = stamp;
+            entry.candidate = (int32_t)candidates.size();
+            child.value = child.reward + entry.eval;
+            candidates.push_back(child);
+        }
+    }
+
+public:
+    explicit TetrisAI(int tableBits = 16) : evaluator(linearEvaluation), stamp(0) {
+        setTableSize(tableBits);
+    }
+
+    // 2^bits entries; clears the table.
+    void setTableSize(int bits) {
+        tableBits = bits;
+        table.assign((size_t)1 << bits, TableEntry{0, 0, 0, 0.0});
+        tableMask = ((uint64_t)1 << bits) - 1;
+    }
+
+    void setConfig(const AIConfig& newConfig) {
+        config = newConfig;
+        if (config.beamWidth < 1) config.beamWidth = 1;
+        if (config.depth < 1) config.depth = 1;
+    }
+
+    // Cached evaluations belong to the old weights, so the table is cleared.
+    void setEvaluator(BoardEvaluator newEvaluator, const EvalWeights& newWeights) {
+        evaluator = newEvaluator;
+        weights = newWeights;
+        setTableSize(tableBits);
+    }
+
+    const AIConfig& getConfig() const {
+        return config;
+    }
+
+    const AIStats& getStats() const {
+        return stats;
+    }
+
+    void resetStats() {
+        stats = AIStats();
+    }
+
+    // Chooses where start should lock on board, given the types of the
+    // pieces that follow it. Returns false if start has no placement.
+    bool plan(const Bitboard& board, const Tetromino& start, const int* upcoming, int upcomingCount, Tetromino& target) {
+        TRACE_ZONE("TetrisAI::plan");
+        auto startTime = std::chrono::steady_clock::now();
+        stats.searches++;
+
+        int plies = std::min(config.depth, 1 + upcomingCount);
+        beam.clear();
+        beam.push_back(BeamNode{board, hashBoard(board), 0.0, 0.0, start});
+
+        for (int ply = 0; ply < plies; ply++) {
+            if (++stamp == 0) {
+                setTableSize(tableBits);
+                stamp = 1;
+            }
+
+            Tetromino piece = start;
+            if (ply > 0) {
+                piece = TetrisCore::spawnPiece(upcoming[ply - 1]);
+            }
+
+            candidates.clear();
+            for (const BeamNode& node : beam) {
+                expand(node, piece, ply == 0);
+            }
+            // Every line of play tops out here; decide on what came before.
+            if (candidates.empty()) {
+                if (ply == 0) beam.clear();
+                break;
+            }
+
+            if ((int)candidates.size() > config.beamWidth) {
+                std::nth_element(candidates.begin(), candidates.begin() + config.beamWidth, candidates.end(), higherValue);
+                candidates.resize(config.beamWidth);
+            }
+            beam.swap(candidates);
+        }
+
+        stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if (beam.empty()) return false;
+        // higherValue sorts best first, so the best node is the "smallest".
+        target = std::min_element(beam.begin(), beam.end(), higherValue)->root;
+        return true;
+    }
+
+    // Plans for the core's current piece using its preview.
+    bool plan(const TetrisCore& core, Tetromino& target) {
+        int next = core.getNextPiece().type;
+        return plan(core.getBoard(), core.getCurrentPiece(), &next, 1, target);
+    }
+
+    // Shortest input sequence that takes the core's current piece to
+    // target, or to another rotation covering the same cells. Returns false
+    // if target is not reachable.
+    bool inputsFor(const TetrisCore& core, const Tetromino& target, std::vector<PlacementMove>& moves) {
+        int count = finder.find(core);
+        for (int i = 0; i < count; i++) {
+            const Placement& placement = finder.get(i);
+            if (sameLock(placement.piece, target)) {
+                moves.resize(placement.inputCount);
+                finder.inputs(placement, moves.data());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Plans and plays the current piece through to locking. Returns false
+    // if it could not be placed.
+    bool playPiece(TetrisCore& core, std::vector<PlacementMove>& moves) {
+        Tetromino target;
+        if (!plan(core, target) || !inputsFor(core, target, moves)) return false;
+        for (PlacementMove move : moves) {
+            applyPlacementMove(core, move);
+        }
+        core.step();
+        return true;
+    }
+};
+
+#endif
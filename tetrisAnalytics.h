@@ -0,0 +1,166 @@
+#ifndef TETRIS_ANALYTICS_H
+#define TETRIS_ANALYTICS_H
+
+// Statistics over recorded games. ReplayAnalyzer opens one replay file at a
+// time, decodes its inputs and, for the queries that need game state,
+// re-simulates it tick by tick while watching the core. Results go into a
+// ReplayStats accumulator.
+//
+// tetrisQuery.cpp gives every worker of a WorkStealingPool its own analyzer
+// and accumulator and merges the accumulators once all files are done, so
+// workers never share anything while they run. A file is mapped only while
+// it is being analyzed, so a corpus far larger than RAM streams through a
+// few files' worth of memory per thread.
+
+#include "tetrisReplay.h"
+#include <cstdint>
+#include <vector>
+
+enum ReplayQuery : uint32_t {
+    // Recorded final score, lines and pieces, read from the footer.
+    QUERY_GAMES = 1 << 0,
+    // How often each input was used.
+    QUERY_INPUTS = 1 << 1,
+    // Lines cleared at once, per level.
+    QUERY_CLEARS = 1 << 2,
+    // Stack height when the game is lost.
+    QUERY_TOP_OUT = 1 << 3,
+    // Which kick each rotation needed.
+    QUERY_KICKS = 1 << 4,
+    QUERY_ALL = (1 << 5) - 1
+};
+
+const uint32_t QUERIES_NEEDING_SIMULATION = QUERY_CLEARS | QUERY_TOP_OUT | QUERY_KICKS;
+
+const char* const REPLAY_QUERY_NAMES[] = {"games", "inputs", "clears", "topout", "kicks"};
+const int REPLAY_QUERY_COUNT = 5;
+
+struct ReplayStats {
+    // Clears at higher levels are counted under MAX_LEVEL.
+    static const int MAX_LEVEL = 20;
+
+    long long files = 0;
+    long long unreadable = 0;
+    long long ticks = 0;
+    long long inputs = 0;
+
+    long long finalScore = 0;
+    long long finalLines = 0;
+    long long finalPieces = 0;
+
+    long long inputCounts[INPUT_COUNT] = {};
+
+    // clears[level][n] counts pieces at that level that cleared n lines.
+    long long clears[MAX_LEVEL + 1][5] = {};
+
+    long long rotations = 0;
+    long long failedRotations = 0;
+    long long kicks[KICK_COUNT] = {};
+
+    long long gameOvers = 0;
+    long long topOutHeights[GRID_HEIGHT + 1] = {};
+
+    // Every member is a counter, so merging is adding them pairwise.
+    void merge(const ReplayStats& other) {
+        const long long* from = (const long long*)&other;
+        long long* to = (long long*)this;
+        for (size_t i = 0; i < sizeof(*this) / sizeof(long long); i++) {
+            to[i] += from[i];
+        }
+    }
+};
+
+static_assert(sizeof(ReplayStats) % sizeof(long long) == 0, "ReplayStats must be all counters");
+
+class ReplayAnalyzer {
+private:
+    uint32_t queries;
+    ReplayFile file;
+    InputRecording recording;
+    TetrisCore core;
+
+    // Counts what changed across one input or tick.
+    void observe(int linesBefore, int levelBefore, bool gameOverBefore, ReplayStats& stats) {
+        int cleared = core.getLines() - linesBefore;
+        if (cleared > 0 && cleared <= 4) {
+            stats.clears[levelBefore < ReplayStats::MAX_LEVEL ? levelBefore : ReplayStats::MAX_LEVEL][cleared]++;
+        }
+        if (!gameOverBefore && core.isGameOver()) {
+            stats.gameOvers++;
+            stats.topOutHeights[core.getBoard().stackHeight()]++;
+        }
+    }
+
+    void apply(GameInput input, ReplayStats& stats) {
+        int lines = core.getLines();
+        int level = core.getLevel();
+        bool gameOver = core.isGameOver();
+        if (input == INPUT_ROTATE) {
+            int kick = core.rotatePiece();
+            stats.rotations++;
+            if (kick < 0) {
+                stats.failedRotations++;
+            } else {
+                stats.kicks[kick]++;
+            }
+        } else {
+            applyInput(core, input);
+        }
+        observe(lines, level, gameOver, stats);
+    }
+
+    void simulate(ReplayStats& stats) {
+        // The same start state as TetrisCore(seed), without building a core.
+        core.reseed(recording.seed);
+        core.setRandomizer(recording.randomizer);
+        core.restartGame();
+
+        const std::vector<InputEvent>& events = recording.events;
+        size_t next = 0;
+        for (uint32_t tick = 0;; tick++) {
+            while (next < events.size() && events[next].tick <= tick) {
+                apply(events[next++].input, stats);
+            }
+            if (tick >= recording.endTick) break;
+
+            int lines = core.getLines();
+            int level = core.getLevel();
+            bool gameOver = core.isGameOver();
+            core.tick();
+            observe(lines, level, gameOver, stats);
+        }
+    }
+
+public:
+    explicit ReplayAnalyzer(uint32_t queries) : queries(queries), core(0) {}
+
+    // Adds one replay file to stats. Returns false if it could not be read.
+    bool analyze(const char* path, ReplayStats& stats) {
+        stats.files++;
+        bool ok = file.open(path) && file.readRecording(recording);
+        file.close();
+        if (!ok) {
+            stats.unreadable++;
+            return false;
+        }
+
+        stats.ticks += recording.endTick;
+        stats.inputs += (long long)recording.events.size();
+        if (queries & QUERY_GAMES) {
+            stats.finalScore += recording.finalScore;
+            stats.finalLines += recording.finalLines;
+            stats.finalPieces += recording.finalPieces;
+        }
+        if (queries & QUERY_INPUTS) {
+            for (const InputEvent& event : recording.events) {
+                stats.inputCounts[event.input]++;
+            }
+        }
+        if (queries & QUERIES_NEEDING_SIMULATION) {
+            simulate(stats);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef TETRIS_BATCH_H
+#define TETRIS_BATCH_H
+
+// Runs many independent tasks across every core, and summarises the numbers
+// they produce. Used by tetrisHeadless.cpp --batch, where each task is one
+// seeded game.
+//
+// WorkStealingPool gives each worker its own deque of task indices, dealt
+// out in contiguous blocks. A worker takes from the back of its own deque
+// and, once that is empty, steals from the front of another's, so a worker
+// stuck on a long game does not leave the rest of its block waiting while
+// other cores sit idle.
+
+#include "tetrisTrace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+private:
+    // One cache line each, so workers taking from their own deque do not
+    // contend with each other.
+    struct alignas(64) WorkQueue {
+        std::mutex lock;
+        std::deque<long long> tasks;
+    };
+
+    int threadCount;
+    std::atomic<long long> steals;
+
+    static bool popBack(WorkQueue& queue, long long& task) {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty()) return false;
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    static bool popFront(WorkQueue& queue, long long& task) {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty()) return false;
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+        return true;
+    }
+
+public:
+    // threads < 1 means one per hardware thread.
+    explicit WorkStealingPool(int threads = 0) : steals(0) {
+        if (threads < 1) threads = (int)std::thread::hardware_concurrency();
+        threadCount = threads < 1 ? 1 : threads;
+    }
+
+    int getThreadCount() const {
+        return threadCount;
+    }
+
+    // Tasks taken from another worker's queue during the last run().
+    long long getSteals() const {
+        return steals.load();
+    }
+
+    // Calls task(index, worker) once for every index in [0, count) and
+    // returns when all of them have finished. worker is in
+    // [0, getThreadCount()) and no two calls with the same worker overlap,
+    // so it can index per-worker state without locking.
+    template <typename Task>
+    void run(long long count, Task task) {
+        std::unique_ptr<WorkQueue[]> queues(new WorkQueue[threadCount]);
+        for (int w = 0; w < threadCount; w++) {
+            long long begin = count * w / threadCount;
+            long long end = count * (w + 1) / threadCount;
+            for (long long i = end - 1; i >= begin; i--) {
+                queues[w].tasks.push_back(i);
+            }
+        }
+        steals = 0;
+
+        auto worker = [&](int w) {
+            // Worker 0 is the calling thread and keeps its own name.
+            if (w > 0 && Tracer::isEnabled()) {
+                Tracer::instance().setThreadName("batch worker " + std::to_string(w));
+            }
+            // Queues only shrink during a run, so once every one has been
+            // seen empty nothing is left to take: the worker exits rather
+            // than waiting, and run() blocks in join() until the tasks
+            // still running elsewhere finish.
+            long long index;
+            while (true) {
+                bool found = popBack(queues[w], index);
+                for (int i = 1; !found && i < threadCount; i++) {
+                    if (popFront(queues[(w + i) % threadCount], index)) {
+                        found = true;
+                        steals.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                if (!found) return;
+                task(index, w);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int w = 1; w < threadCount; w++) {
+            threads.emplace_back(worker, w);
+        }
+        worker(0);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+};
+
+// Summary of one per-game quantity: mean, percentiles and an equal-width
+// histogram between the smallest and largest value.
+struct Distribution {
+    static const int HISTOGRAM_BUCKETS = 10;
+
+    long long count = 0;
+    double mean = 0.0;
+    long long min = 0;
+    long long p50 = 0;
+    long long p90 = 0;
+    long long p99 = 0;
+    long long max = 0;
+    long long bucketWidth = 1;
+    long long buckets[HISTOGRAM_BUCKETS] = {};
+
+    // Nearest-rank percentile of sorted values.
+    static long long percentile(const std::vector<long long>& sorted, double p) {
+        size_t rank = (size_t)(p * sorted.size() + 0.999999);
+        if (rank < 1) rank = 1;
+        return sorted[std::min(rank, sorted.size()) - 1];
+    }
+
+    static Distribution of(std::vector<long long> values) {
+        Distribution d;
+        if (values.empty()) return d;
+        std::sort(values.begin(), values.end());
+
+        d.count = (long long)values.size();
+        double sum = 0.0;
+        for (long long value : values) {
+            sum += value;
+        }
+        d.mean = sum / d.count;
+        d.min = values.front();
+        d.max = values.back();
+        d.p50 = percentile(values, 0.50);
+        d.p90 = percentile(values, 0.90);
+        d.p99 = percentile(values, 0.99);
+
+        d.bucketWidth = (d.max - d.min) / HISTOGRAM_BUCKETS + 1;
+        for (long long value : values) {
+            d.buckets[(value - d.min) / d.bucketWidth]++;
+        }
+        return d;
+    }
+};
+
+#endif
@@ -0,0 +1,456 @@
+#include "tetrisAI.h"
+#include "tetrisCore.h"
+#include "tetrisDraw.h"
+#include "tetrisFont.h"
+#include "tetrisRaster.h"
+#include "tetrisScene.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Microbenchmarks for the game core and for building a frame's draw data,
+// written as JSON so results can be diffed across commits:
+//
+//   tetrisBench [--out results.json] [--filter name] [--reps N]
+//               [--rep-ms MS] [--warmup-ms MS] [--seed S]
+//
+// Every benchmark runs its body for --warmup-ms first, then picks an
+// iteration count that makes one repetition last about --rep-ms, then times
+// --reps repetitions of that many iterations. The median time per iteration
+// is the number to compare; min, mean and stddev show how noisy the run was.
+//
+// Inputs are built from --seed before timing starts: random stacks of
+// varied heights with no full rows, pieces at random positions on them,
+// and boards with 0 to 4 full rows placed at random heights in the stack.
+// Benchmarks that change a core work on a copy of a prepared one, so
+// core_copy is timed too and can be subtracted from them.
+//
+// placement_search is one PlacementFinder::find() from the spawn position,
+// the breadth-first search that also keeps input sequences, lock_search the
+// findLocks() flood the AI runs for every node it expands, and ai_plan one
+// TetrisAI::plan() with the default beam and depth.
+//
+// The frame benchmarks draw TetrisScene through NullCanvas, which builds
+// the same quads, text quads and board cells as the window's OpenGL canvas
+// and submits nothing, so they measure the CPU side of a frame.
+
+// Keeps the compiler from dropping a result nothing else reads.
+template <typename T>
+inline void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile T sink;
+    sink = value;
+#endif
+}
+
+struct BenchConfig {
+    int reps = 15;
+    double repMs = 20.0;
+    double warmupMs = 100.0;
+    unsigned int seed = 1;
+    const char* filter = NULL;
+};
+
+struct BenchResult {
+    string name;
+    long long iterations;
+    // Seconds per iteration of each repetition.
+    vector<double> samples;
+    // Per-iteration counters worth reporting alongside the time.
+    vector<pair<string, double>> counters;
+};
+
+typedef function<void(long long)> BenchBody;
+
+double secondsFor(const BenchBody& body, long long iterations) {
+    auto start = chrono::steady_clock::now();
+    body(iterations);
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+BenchResult runBench(const BenchConfig& config, const string& name, const BenchBody& body) {
+    BenchResult result;
+    result.name = name;
+
+    auto warmupEnd = chrono::steady_clock::now() + chrono::duration<double, milli>(config.warmupMs);
+    while (chrono::steady_clock::now() < warmupEnd) body(64);
+
+    long long iterations = 1;
+    double seconds = secondsFor(body, iterations);
+    while (seconds * 1000.0 < config.repMs / 4 && iterations < (1ll << 40)) {
+        iterations *= 2;
+        seconds = secondsFor(body, iterations);
+    }
+    if (seconds > 0) iterations = max(1ll, (long long)(iterations * (config.repMs / 1000.0) / seconds));
+    result.iterations = iterations;
+
+    for (int rep = 0; rep < config.reps; rep++) {
+        result.samples.push_back(secondsFor(body, iterations) / iterations);
+    }
+    return result;
+}
+
+// A random stack of the given height whose rows each have at least one gap.
+template <typename Core>
+void fillStack(Core& core, Pcg32& rng, int height) {
+    typename Core::State state;
+    core.restartGame();
+    core.saveState(state);
+    for (int y = Core::HEIGHT - height; y < Core::HEIGHT; y++) {
+        for (int x = 0; x < Core::WIDTH; x++) {
+            state.cells[y][x] = rng.bounded(10) < 7 ? (uint8_t)(1 + rng.bounded(PIECE_TYPES)) : 0;
+        }
+        state.cells[y][rng.bounded(Core::WIDTH)] = 0;
+    }
+    core.loadState(state);
+}
+
+template <typename Core>
+void setPiece(Core& core, const Tetromino& piece) {
+    typename Core::State state;
+    core.saveState(state);
+    state.currentPiece = piece;
+    core.loadState(state);
+}
+
+Tetromino randomPiece(Pcg32& rng, int minX, int maxX, int minY, int maxY) {
+    Tetromino piece;
+    piece.setType((int)rng.bounded(PIECE_TYPES));
+    piece.rotation = (int8_t)rng.bounded(PIECE_ROTATIONS);
+    piece.x = (int8_t)(minX + (int)rng.bounded((uint32_t)(maxX - minX + 1)));
+    piece.y = (int8_t)(minY + (int)rng.bounded((uint32_t)(maxY - minY + 1)));
+    return piece;
+}
+
+// Cores whose current piece fits, rotates with the first kick when kicked
+// is false and needs a later one when it is true.
+vector<TetrisCore> rotationCores(Pcg32& rng, bool kicked, int count) {
+    vector<TetrisCore> cores;
+    TetrisCore core(rng.next());
+    while ((int)cores.size() < count) {
+        fillStack(core, rng, 4 + (int)rng.bounded(12));
+        Tetromino piece = randomPiece(rng, -BOARD_WALL, GRID_WIDTH - 1, 0, GRID_HEIGHT - 2);
+        setPiece(core, piece);
+        if (core.checkCollision(piece, 0, 0)) continue;
+        TetrisCore probe = core;
+        int kick = probe.rotatePiece();
+        if (kick < 0 || (kick > 0) != kicked) continue;
+        cores.push_back(core);
+    }
+    return cores;
+}
+
+// Cores with full rows at random heights inside a stack of 4 to 16 rows.
+vector<TetrisCore> clearingCores(Pcg32& rng, int fullRows, int count) {
+    vector<TetrisCore> cores;
+    TetrisCore core(rng.next());
+    for (int i = 0; i < count; i++) {
+        int height = max(fullRows, 4 + (int)rng.bounded(13));
+        fillStack(core, rng, height);
+        TetrisState state;
+        core.saveState(state);
+        for (int filled = 0; filled < fullRows;) {
+            int y = GRID_HEIGHT - 1 - (int)rng.bounded((uint32_t)height);
+            bool full = true;
+            for (int x = 0; x < GRID_WIDTH; x++) full = full && state.cells[y][x];
+            if (full) continue;
+            for (int x = 0; x < GRID_WIDTH; x++) {
+                if (!state.cells[y][x]) state.cells[y][x] = (uint8_t)(1 + rng.bounded(PIECE_TYPES));
+            }
+            filled++;
+        }
+        core.loadState(state);
+        cores.push_back(core);
+    }
+    return cores;
+}
+
+// Cores whose current piece has been hard dropped onto a random stack.
+vector<TetrisCore> landedCores(Pcg32& rng, int count) {
+    vector<TetrisCore> cores;
+    TetrisCore core(rng.next());
+    while ((int)cores.size() < count) {
+        fillStack(core, rng, (int)rng.bounded(15));
+        Tetromino piece = randomPiece(rng, -BOARD_WALL, GRID_WIDTH - 1, 0, 0);
+        setPiece(core, piece);
+        if (core.checkCollision(piece, 0, 0)) continue;
+        core.hardDrop();
+        cores.push_back(core);
+    }
+    return cores;
+}
+
+void addCoreBenches(const BenchConfig& config, vector<pair<string, BenchBody>>& benches) {
+    Pcg32 rng(config.seed);
+    const int POOL = 1024;
+
+    struct Query {
+        uint16_t board;
+        Tetromino piece;
+    };
+    auto boards = make_shared<vector<TetrisCore>>();
+    auto queries = make_shared<vector<Query>>();
+    for (int i = 0; i < 64; i++) {
+        TetrisCore core(rng.next());
+        fillStack(core, rng, (int)rng.bounded(17));
+        boards->push_back(core);
+    }
+    for (int i = 0; i < 4096; i++) {
+        Query query = {(uint16_t)rng.bounded(64), randomPiece(rng, -BOARD_WALL, GRID_WIDTH - 1, -2, GRID_HEIGHT - 1)};
+        queries->push_back(query);
+    }
+    benches.push_back(make_pair("check_collision", [boards, queries](long long iterations) {
+        int hits = 0;
+        for (long long i = 0; i < iterations; i++) {
+            const Query& query = (*queries)[i & 4095];
+            hits += (*boards)[query.board].checkCollision(query.piece, 0, 0);
+        }
+        keep(hits);
+    }));
+
+    auto landed = make_shared<vector<TetrisCore>>(landedCores(rng, POOL));
+    benches.push_back(make_pair("core_copy", [landed](long long iterations) {
+        TetrisCore work = (*landed)[0];
+        for (long long i = 0; i < iterations; i++) {
+            work = (*landed)[i & (POOL - 1)];
+            keep(work);
+        }
+    }));
+
+    const char* rotateNames[2] = {"rotate_no_kick", "rotate_kick"};
+    for (int kicked = 0; kicked < 2; kicked++) {
+        auto cores = make_shared<vector<TetrisCore>>(rotationCores(rng, kicked != 0, POOL));
+        benches.push_back(make_pair(rotateNames[kicked], [cores](long long iterations) {
+            TetrisCore work = (*cores)[0];
+            int kicks = 0;
+            for (long long i = 0; i < iterations; i++) {
+                work = (*cores)[i & (POOL - 1)];
+                kicks += work.rotatePiece();
+            }
+            keep(kicks);
+        }));
+    }
+
+    for (int fullRows = 0; fullRows <= 4; fullRows++) {
+        auto cores = make_shared<vector<TetrisCore>>(clearingCores(rng, fullRows, POOL));
+        benches.push_back(make_pair("clear_lines_" + to_string(fullRows), [cores](long long iterations) {
+            TetrisCore work = (*cores)[0];
+            int cleared = 0;
+            for (long long i = 0; i < iterations; i++) {
+                work = (*cores)[i & (POOL - 1)];
+                cleared += work.clearLines();
+            }
+            keep(cleared);
+        }));
+    }
+
+    benches.push_back(make_pair("place_piece", [landed](long long iterations) {
+        TetrisCore work = (*landed)[0];
+        int score = 0;
+        for (long long i = 0; i < iterations; i++) {
+            work = (*landed)[i & (POOL - 1)];
+            work.placePiece();
+            score += work.getScore();
+        }
+        keep(score);
+    }));
+
+    // One gravity step of a game, after a random move most of the time;
+    // lost games restart, as in the headless random player.
+    auto moves = make_shared<vector<uint8_t>>();
+    for (int i = 0; i < 4096; i++) {
+        moves->push_back((uint8_t)rng.bounded(5));
+    }
+    auto game = make_shared<TetrisCore>(rng.next());
+    benches.push_back(make_pair("game_step", [moves, game](long long iterations) {
+        TetrisCore& core = *game;
+        for (long long i = 0; i < iterations; i++) {
+            switch ((*moves)[i & 4095]) {
+                case 0: core.movePiece(-1, 0); break;
+                case 1: core.movePiece(1, 0); break;
+                case 2: core.rotatePiece(); break;
+                default: break;
+            }
+            core.step();
+            if (core.isGameOver()) core.restartGame();
+        }
+        keep(core.getScore());
+    }));
+}
+
+// Searches from a freshly spawned piece on random stacks up to 14 rows high,
+// as the AI meets them mid-game.
+void addSearchBenches(const BenchConfig& config, vector<pair<string, BenchBody>>& benches,
+                      vector<pair<string, double>>& placementCounts) {
+    Pcg32 rng(config.seed ^ 0xB5F5u);
+    const int POOL = 256;
+    auto cores = make_shared<vector<TetrisCore>>();
+    TetrisCore core(rng.next());
+    long long placements = 0;
+    PlacementFinder counter;
+    while ((int)cores->size() < POOL) {
+        fillStack(core, rng, (int)rng.bounded(15));
+        setPiece(core, TetrisCore::spawnPiece((int)rng.bounded(PIECE_TYPES)));
+        if (core.checkCollision(core.getCurrentPiece(), 0, 0)) continue;
+        placements += counter.find(core);
+        cores->push_back(core);
+    }
+    placementCounts.push_back(make_pair("placement_search", (double)placements / POOL));
+    placementCounts.push_back(make_pair("lock_search", (double)placements / POOL));
+
+    auto finder = make_shared<PlacementFinder>();
+    benches.push_back(make_pair("placement_search", [cores, finder](long long iterations) {
+        int found = 0;
+        for (long long i = 0; i < iterations; i++) {
+            found += finder->find((*cores)[i & (POOL - 1)]);
+        }
+        keep(found);
+    }));
+
+    benches.push_back(make_pair("lock_search", [cores, finder](long long iterations) {
+        int found = 0;
+        for (long long i = 0; i < iterations; i++) {
+            const TetrisCore& core = (*cores)[i & (POOL - 1)];
+            found += finder->findLocks(core.getBoard(), core.getCurrentPiece());
+        }
+        keep(found);
+    }));
+
+    auto ai = make_shared<TetrisAI>();
+    benches.push_back(make_pair("ai_plan", [cores, ai](long long iterations) {
+        Tetromino target;
+        int planned = 0;
+        for (long long i = 0; i < iterations; i++) {
+            planned += ai->plan((*cores)[i & (POOL - 1)], target);
+        }
+        keep(planned);
+    }));
+}
+
+// The frame the window draws while a piece falls mid-game: idle reuses the
+// cached board and panel layers, full redraws every layer as after a lock.
+void addFrameBenches(const BenchConfig& config, vector<pair<string, BenchBody>>& benches,
+                     vector<pair<string, double>>& frameQuads) {
+    Pcg32 rng(config.seed ^ 0xF4A3Eu);
+    auto core = make_shared<TetrisCore>(rng.next());
+    fillStack(*core, rng, 8);
+    auto canvas = make_shared<NullCanvas>();
+    auto scene = make_shared<TetrisScene<NullCanvas>>(*canvas);
+    auto ui = make_shared<SceneUi>();
+
+    const char* names[2] = {"frame_idle", "frame_full"};
+    for (int full = 0; full < 2; full++) {
+        BenchBody body = [core, canvas, scene, ui, full](long long iterations) {
+            for (long long i = 0; i < iterations; i++) {
+                if (full) canvas->invalidateAll();
+                scene->render(*core, *ui, (float)(i & 7) / 8.0f);
+            }
+        };
+        benches.push_back(make_pair(names[full], body));
+
+        // Quads per frame, counted outside the timed runs once the first
+        // frame has filled the layers.
+        body(1);
+        long long before = canvas->getQuadsBuilt();
+        body(1);
+        frameQuads.push_back(make_pair(names[full], (double)(canvas->getQuadsBuilt() - before)));
+    }
+}
+
+void writeJson(ostream& out, const BenchConfig& config, const vector<BenchResult>& results) {
+    out << "{\n  \"benchmark\": \"tetrisBench\",\n  \"config\": {\"reps\": " << config.reps
+        << ", \"repMs\": " << config.repMs << ", \"warmupMs\": " << config.warmupMs << ", \"seed\": " << config.seed
+        << ", \"coreBytes\": " << sizeof(TetrisCore) << "},\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        vector<double> sorted = result.samples;
+        sort(sorted.begin(), sorted.end());
+        double median = sorted[sorted.size() / 2];
+        double mean = 0.0;
+        for (double sample : sorted) mean += sample;
+        mean /= sorted.size();
+        double variance = 0.0;
+        for (double sample : sorted) variance += (sample - mean) * (sample - mean);
+        double stddev = sqrt(variance / sorted.size());
+
+        out << (i ? "," : "") << "\n    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+            << ", \"medianNs\": " << median * 1e9 << ", \"minNs\": " << sorted.front() * 1e9
+            << ", \"meanNs\": " << mean * 1e9 << ", \"stddevNs\": " << stddev * 1e9
+            << ", \"perSecond\": " << (median > 0 ? 1.0 / median : 0.0);
+        for (const auto& counter : result.counters) {
+            out << ", \"" << counter.first << "\": " << counter.second;
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    const char* outPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            config.filter = argv[++i];
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            config.reps = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--rep-ms") == 0 && i + 1 < argc) {
+            config.repMs = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup-ms") == 0 && i + 1 < argc) {
+            config.warmupMs = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else {
+            cerr << "Usage: " << argv[0]
+                 << " [--out results.json] [--filter name] [--reps N] [--rep-ms MS] [--warmup-ms MS] [--seed S]" << endl;
+            return 1;
+        }
+    }
+
+    vector<pair<string, BenchBody>> benches;
+    vector<pair<string, double>> frameQuads;
+    vector<pair<string, double>> placementCounts;
+    addCoreBenches(config, benches);
+    addSearchBenches(config, benches, placementCounts);
+    addFrameBenches(config, benches, frameQuads);
+
+    vector<BenchResult> results;
+    for (const auto& bench : benches) {
+        if (config.filter && bench.first.find(config.filter) == string::npos) continue;
+        BenchResult result = runBench(config, bench.first, bench.second);
+        for (const auto& quads : frameQuads) {
+            if (quads.first == bench.first) result.counters.push_back(make_pair("quadsPerFrame", quads.second));
+        }
+        for (const auto& placements : placementCounts) {
+            if (placements.first == bench.first) result.counters.push_back(make_pair("placements", placements.second));
+        }
+        cerr << result.name << ": " << result.samples.size() << " x " << result.iterations << " iterations" << endl;
+        results.push_back(result);
+    }
+
+    if (outPath) {
+        ofstream out(outPath);
+        if (!out) {
+            cerr << "Cannot write " << outPath << endl;
+            return 1;
+        }
+        writeJson(out, config, results);
+    } else {
+        writeJson(cout, config, results);
+    }
+    return 0;
+}
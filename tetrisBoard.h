@@ -0,0 +1,324 @@
+#ifndef TETRIS_BOARD_H
+#define TETRIS_BOARD_H
+
+// Playfield stored as one word per row. A collision test ORs the walls
+// left and right of the field into each row and ANDs it with the piece's
+// row, and the floor below the field is stored as full rows, so there are
+// no bounds checks inside the field.
+//
+// The board also keeps its surface up to date as cells are set and rows
+// removed: the height of every column and the number of holes, empty cells
+// with a filled cell somewhere above them. Evaluators read them directly, and
+// a hard drop is the smallest gap between the piece and the surface below it.
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// The narrowest unsigned integer with at least Bits bits.
+template <int Bits>
+using UintFor = typename std::conditional<Bits <= 8, uint8_t,
+                typename std::conditional<Bits <= 16, uint16_t,
+                typename std::conditional<Bits <= 32, uint32_t, uint64_t>::type>::type>::type;
+
+// A 4-bit piece row shifted to every column a piece origin can take.
+template <typename Row, int Origins>
+struct ShiftedRowTable {
+    Row masks[16][Origins];
+
+    constexpr ShiftedRowTable() : masks() {
+        for (int bits = 0; bits < 16; bits++) {
+            for (int col = 0; col < Origins; col++) {
+                masks[bits][col] = (Row)((uint64_t)bits << col);
+            }
+        }
+    }
+};
+
+// value must be non-zero.
+template <typename T>
+inline int lowestSetBit(T value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return sizeof(T) <= 4 ? __builtin_ctz((uint32_t)value) : __builtin_ctzll((uint64_t)value);
+#else
+    int bit = 0;
+    while (!(value & 1)) {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// value must be non-zero.
+inline int highestSetBit(uint32_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 31 - __builtin_clz(value);
+#else
+    int bit = 0;
+    while (value >>= 1) bit++;
+    return bit;
+#endif
+}
+
+template <typename T>
+inline int countSetBits(T value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return sizeof(T) <= 4 ? __builtin_popcount((uint32_t)value) : __builtin_popcountll((uint64_t)value);
+#else
+    int count = 0;
+    for (; value; value &= value - 1) count++;
+    return count;
+#endif
+}
+
+// Width x Height field. Each row is stored as its Width cells in the
+// narrowest word that holds them, uint16_t for boards up to 16 wide, and
+// the walls are ORed in as the row is read. Below the field are FLOOR rows
+// stored full.
+template <int Width, int Height>
+class BasicBitboard {
+public:
+    static const int WIDTH = Width;
+    static const int HEIGHT = Height;
+    static const int WALL = 3;
+    static const int TOP = 4;
+    static const int FLOOR = 4;
+    // Rows of getColumns(): TOP empty rows above the field, the field and
+    // the floor.
+    static const int ROWS = TOP + Height + FLOOR;
+    static const int COLUMNS = Width + 2 * WALL;
+
+    static_assert(Width >= 4 && Height >= 4, "board too small for a piece");
+    static_assert(COLUMNS <= 64, "board too wide for a row word");
+    static_assert(ROWS <= 64, "board too tall for a column word");
+
+    // A stored row: bit x is column x.
+    typedef UintFor<Width> FieldRow;
+    // A row with its walls, bit (x + WALL) for column x, as pieces are
+    // tested against it.
+    typedef UintFor<COLUMNS> Row;
+    // One column of getColumns(), walls and floor included.
+    typedef UintFor<ROWS> Column;
+
+    static constexpr FieldRow FIELD_BITS = (FieldRow)(~0ull >> (64 - Width));
+    static constexpr Row FULL_ROW = (Row)(~0ull >> (64 - COLUMNS));
+    static constexpr Row FIELD_ROW = (Row)((Row)FIELD_BITS << WALL);
+    static constexpr Row EMPTY_ROW = (Row)(FULL_ROW & ~FIELD_ROW);
+
+    // Origins x = -WALL .. Width - 1.
+    static constexpr ShiftedRowTable<Row, Width + WALL> SHIFTED_ROWS{};
+
+private:
+    FieldRow rows[Height + FLOOR];
+    // Wider than a byte, since a field can have more than 255 cells; kept
+    // ahead of heights so it packs against the rows.
+    uint16_t holes;
+    // Rows from the bottom of the field up to each column's highest cell.
+    uint8_t heights[Width];
+
+    // Updates the surface for a newly set cell.
+    void addToSurface(int x, int y) {
+        int height = Height - y;
+        if (height > heights[x]) {
+            holes = (uint16_t)(holes + height - 1 - heights[x]);
+            heights[x] = (uint8_t)height;
+        } else {
+            holes--;
+        }
+    }
+
+    static Row withWalls(FieldRow bits) {
+        return (Row)((Row)bits << WALL | EMPTY_ROW);
+    }
+
+public:
+    BasicBitboard() {
+        clear();
+    }
+
+    void clear() {
+        for (int i = 0; i < Height; i++) {
+            rows[i] = 0;
+        }
+        for (int i = Height; i < Height + FLOOR; i++) {
+            rows[i] = FIELD_BITS;
+        }
+        for (int x = 0; x < Width; x++) {
+            heights[x] = 0;
+        }
+        holes = 0;
+    }
+
+    // pieceRows[r] holds the 4 cells of piece row r, bit c for column x + c.
+    // Rows above the field hold only the walls, which matches the old grid
+    // test that let pieces poke out of the top.
+    bool collides(const uint8_t pieceRows[4], int x, int y) const {
+        if (x < -WALL || x >= Width || y >= Height) return true;
+
+        const int col = x + WALL;
+        if (y < 0) {
+            for (int r = 0; r < 4; r++) {
+                Row row = y + r < 0 ? EMPTY_ROW : withWalls(rows[y + r]);
+                if (row & SHIFTED_ROWS.masks[pieceRows[r]][col]) return true;
+            }
+            return false;
+        }
+
+        const FieldRow* r = rows + y;
+        return ((withWalls(r[0]) & SHIFTED_ROWS.masks[pieceRows[0]][col]) |
+                (withWalls(r[1]) & SHIFTED_ROWS.masks[pieceRows[1]][col]) |
+                (withWalls(r[2]) & SHIFTED_ROWS.masks[pieceRows[2]][col]) |
+                (withWalls(r[3]) & SHIFTED_ROWS.masks[pieceRows[3]][col])) != 0;
+    }
+
+    bool isOccupied(int x, int y) const {
+        return (rows[y] >> x) & 1;
+    }
+
+    void setCell(int x, int y) {
+        if (isOccupied(x, y)) return;
+        rows[y] |= (FieldRow)((FieldRow)1 << x);
+        addToSurface(x, y);
+    }
+
+    // Sets the piece's cells. Cells above the field are dropped, the same as
+    // when TetrisCore locks a piece.
+    void placeRows(const uint8_t pieceRows[4], int x, int y) {
+        for (int r = 0; r < 4; r++) {
+            if (y + r >= 0 && pieceRows[r]) {
+                FieldRow added = (FieldRow)(SHIFTED_ROWS.masks[pieceRows[r]][x + WALL] >> WALL & ~rows[y + r]);
+                rows[y + r] |= added;
+                for (; added; added &= (FieldRow)(added - 1)) {
+                    addToSurface(lowestSetBit(added), y + r);
+                }
+            }
+        }
+    }
+
+    // Rows from the bottom of the field up to its highest filled cell.
+    int stackHeight() const {
+        for (int y = 0; y < Height; y++) {
+            if (rows[y]) return Height - y;
+        }
+        return 0;
+    }
+
+    bool isRowFull(int y) const {
+        return rows[y] == FIELD_BITS;
+    }
+
+    // Removes row y and shifts every row above it down by one.
+    void removeRow(int y) {
+        const int rowHeight = Height - y;
+        for (int x = 0; x < Width; x++) {
+            if (heights[x] < rowHeight) continue;
+            if (!isOccupied(x, y)) {
+                holes--;
+                heights[x]--;
+            } else if (heights[x] > rowHeight) {
+                heights[x]--;
+            } else {
+                // The column's top cell goes, and the empty cells down to the
+                // next filled one stop being holes.
+                int below = y + 1;
+                while (below < Height && !isOccupied(x, below)) below++;
+                int height = Height - below;
+                holes = (uint16_t)(holes - (heights[x] - 1 - height));
+                heights[x] = (uint8_t)height;
+            }
+        }
+        memmove(rows + 1, rows, y * sizeof(FieldRow));
+        rows[0] = 0;
+    }
+
+    // Removes every full row and returns how many there were.
+    int clearFullRows() {
+        int cleared = 0;
+        for (int y = Height - 1; y >= 0; y--) {
+            if (isRowFull(y)) {
+                removeRow(y);
+                cleared++;
+                y++;
+            }
+        }
+        return cleared;
+    }
+
+    int columnHeight(int x) const {
+        return heights[x];
+    }
+
+    // Every column's height, Width entries.
+    const uint8_t* getHeights() const {
+        return heights;
+    }
+
+    int holeCount() const {
+        return holes;
+    }
+
+    // How many rows a piece at (x, y) falls in a hard drop, where bottoms[c]
+    // is the piece's lowest cell in column x + c. When the piece is above
+    // the surface in every column it covers, that is the smallest gap down
+    // to the surface, one lookup per column. A piece tucked under an
+    // overhang steps down one row at a time instead. The gaps start from
+    // Height - y, more than any of them, since a piece above the field
+    // falls further than Height rows.
+    int dropDistance(const uint8_t pieceRows[4], const int8_t bottoms[4], int x, int y) const {
+        int distance = Height - y;
+        for (int c = 0; c < 4; c++) {
+            if (bottoms[c] < 0) continue;
+            int column = x + c;
+            int cellY = y + bottoms[c];
+            int surface = column >= 0 && column < Width ? Height - heights[column] : -1;
+            if (cellY >= surface) {
+                distance = 0;
+                while (!collides(pieceRows, x, y + distance + 1)) distance++;
+                return distance;
+            }
+            if (surface - 1 - cellY < distance) distance = surface - 1 - cellY;
+        }
+        return distance;
+    }
+
+    // Row y's cells, bit (x + WALL) for column x.
+    Row getRow(int y) const {
+        return (Row)((Row)rows[y] << WALL);
+    }
+
+    // Transposed board: bit i of columns[c] is bit c of row i - TOP with its
+    // walls, so row 0 is TOP rows above the field. Walls and floor included.
+    void getColumns(Column columns[COLUMNS]) const {
+        // The walls are solid and the floor full, so only the field's
+        // filled cells are left to set, a bit each.
+        const Column solid = (Column)(~0ull >> (64 - ROWS));
+        const Column floor = (Column)(solid >> (TOP + Height) << (TOP + Height));
+        for (int c = 0; c < COLUMNS; c++) {
+            columns[c] = c < WALL || c >= WALL + Width ? solid : floor;
+        }
+        for (int y = 0; y < Height; y++) {
+            for (FieldRow bits = rows[y]; bits; bits &= (FieldRow)(bits - 1)) {
+                columns[WALL + lowestSetBit(bits)] |= (Column)((Column)1 << (TOP + y));
+            }
+        }
+    }
+};
+
+// The board the window, the AI and replay files use.
+typedef BasicBitboard<15, 20> Bitboard;
+typedef Bitboard::Row BoardRow;
+
+const int GRID_WIDTH = Bitboard::WIDTH;
+const int GRID_HEIGHT = Bitboard::HEIGHT;
+const int BOARD_WALL = Bitboard::WALL;
+const int BOARD_TOP = Bitboard::TOP;
+const int BOARD_FLOOR = Bitboard::FLOOR;
+const int BOARD_ROWS = Bitboard::ROWS;
+const int BOARD_COLUMNS = Bitboard::COLUMNS;
+
+const BoardRow FULL_ROW = Bitboard::FULL_ROW;
+const BoardRow FIELD_ROW = Bitboard::FIELD_ROW;
+const BoardRow EMPTY_ROW = Bitboard::EMPTY_ROW;
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef TETRIS_CLOCK_H
+#define TETRIS_CLOCK_H
+
+// Turns wall-clock time into a count of fixed simulation ticks. The window
+// reads the time once per frame, which can be any rate (30 Hz, 240 Hz or
+// uncapped), and runs however many TetrisCore ticks have come due since.
+//
+// Time is kept as an integer number of SUBTICKS, fractions of a tick, so
+// the ticks run over a session are exactly the elapsed time divided by the
+// tick length: per-frame rounding never accumulates into drift, and the
+// simulation itself only ever sees whole ticks. What is left over after the
+// due ticks have run is how far the display is between two ticks, which the
+// renderer uses to interpolate.
+
+#include "tetrisCore.h"
+#include <cmath>
+#include <cstdint>
+
+class TickClock {
+public:
+    // Fixed-point resolution of one tick.
+    static const int64_t SUBTICKS = 1 << 16;
+    // After a stall (a dragged window, a breakpoint) at most this many
+    // ticks are caught up; the rest of the time is dropped.
+    static const int MAX_CATCH_UP = TICKS_PER_SECOND / 4;
+
+private:
+    int64_t now;
+    int64_t pending;
+
+    static int64_t toSubticks(double seconds) {
+        return (int64_t)std::llround(seconds * TICKS_PER_SECOND * SUBTICKS);
+    }
+
+public:
+    explicit TickClock(double seconds = 0.0) : now(toSubticks(seconds)), pending(0) {}
+
+    // Adds the time since the last advance() or hold().
+    void advance(double seconds) {
+        int64_t time = toSubticks(seconds);
+        pending += time - now;
+        now = time;
+        if (pending > MAX_CATCH_UP * SUBTICKS) {
+            pending = MAX_CATCH_UP * SUBTICKS;
+        }
+    }
+
+    // Moves to seconds without adding the time in between, for while the
+    // game is frozen.
+    void hold(double seconds) {
+        now = toSubticks(seconds);
+    }
+
+    // Takes one due tick, if there is one.
+    bool nextTick() {
+        if (pending < SUBTICKS) return false;
+        pending -= SUBTICKS;
+        return true;
+    }
+
+    // Wall-clock time at which the tick last taken by nextTick() came due.
+    double tickDueTime() const {
+        return (double)(now - pending) / ((double)TICKS_PER_SECOND * SUBTICKS);
+    }
+
+    // Time until the next tick comes due.
+    double secondsToNextTick() const {
+        return (double)(SUBTICKS - pending) / ((double)TICKS_PER_SECOND * SUBTICKS);
+    }
+
+    // How far the display is past the last tick run, in [0, 1).
+    double getAlpha() const {
+        return (double)pending / SUBTICKS;
+    }
+};
+
+#endif
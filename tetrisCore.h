@@ -0,0 +1,418 @@
+#ifndef TETRIS_CORE_H
+#define TETRIS_CORE_H
+
+// Game rules for Tetris with no OpenGL or GLFW dependency. TetrisGame in
+// tetrisFinal.cpp drives this from the window; tetrisHeadless.cpp drives it
+// directly so games can run on machines without a display or GPU.
+//
+// The rules are a template on the board size, so each variant gets its own
+// fully specialized board and inner loops and one binary can run several.
+// VisibleHeight rows at the bottom are shown; rows above them are a hidden
+// buffer that new pieces spawn into. TetrisCore is the 15x20 game the
+// window, the AI and replay files use.
+
+#include "tetrisBoard.h"
+#include "tetrisPieces.h"
+#include "tetrisRandom.h"
+#include "tetrisTrace.h"
+#include <cstring>
+#include <random>
+
+const int SCORE_VALUES[4] = {40, 100, 300, 1200};
+
+// Gravity runs on fixed ticks rather than wall-clock time, so the same seed
+// and the same inputs at the same ticks always play out the same game. All
+// timing inside the core is whole ticks and integer arithmetic, so that
+// holds across compilers and machines too.
+const int TICKS_PER_SECOND = 60;
+
+// Everything needed to resume a game exactly, the piece generator's state
+// included.
+template <int Width, int Height>
+struct BasicTetrisState {
+    uint8_t cells[Height][Width];
+    Tetromino currentPiece;
+    Tetromino nextPiece;
+    int32_t score;
+    int32_t level;
+    int32_t linesCleared;
+    int32_t piecesPlaced;
+    int32_t ticksSinceFall;
+    PieceGenerator pieces;
+    bool gameOver;
+    bool gamePaused;
+};
+
+// A live game is only its rules state, a couple of hundred bytes with no
+// pointers or heap memory, so hundreds of thousands can be held at once and
+// copied freely. Shapes, kicks and colors come from the shared constant
+// tables in tetrisPieces.h, and everything to do with a window (layout,
+// buttons, GL objects) lives with the window.
+template <int Width, int Height, int VisibleHeight = Height>
+class BasicTetrisCore {
+public:
+    static const int WIDTH = Width;
+    static const int HEIGHT = Height;
+    static const int VISIBLE_HEIGHT = VisibleHeight;
+    static const int HIDDEN_ROWS = Height - VisibleHeight;
+    // Pieces spawn with their cells in the two hidden rows just above the
+    // visible ones, or at the top when there is no hidden buffer.
+    static const int SPAWN_ROW = HIDDEN_ROWS > 2 ? HIDDEN_ROWS - 3 : 0;
+
+    static_assert(VisibleHeight > 0 && VisibleHeight <= Height, "visible rows must fit in the board");
+
+    typedef BasicBitboard<Width, Height> Board;
+    typedef BasicTetrisState<Width, Height> State;
+    typedef typename Board::FieldRow FieldRow;
+
+    // Ticks between gravity steps at level 1.
+    static const int BASE_FALL_TICKS = TICKS_PER_SECOND;
+    // Bits of a cell's getCell() value, one bit plane each.
+    static const int TYPE_BITS = 3;
+
+private:
+    Board board;
+    // Bit x of typePlanes[b][y] is bit b of getCell(x, y).
+    FieldRow typePlanes[TYPE_BITS][Height];
+    // The narrow fields sit between the rows and the generator, whose
+    // alignment would otherwise leave a gap there. A gravity step is at
+    // most BASE_FALL_TICKS apart, so the tick counts fit in a byte.
+    uint8_t ticksSinceFall;
+    uint8_t fallTicks;
+    bool gameOver;
+    bool gamePaused;
+    uint16_t boardVersion;
+    PieceGenerator pieces;
+    int32_t score;
+    int32_t level;
+    int32_t linesCleared;
+    int32_t piecesPlaced;
+    Tetromino currentPiece;
+    Tetromino nextPiece;
+
+    int drawPieceType() {
+        return pieces.next();
+    }
+
+    void setCellType(int x, int y, int value) {
+        for (int b = 0; b < TYPE_BITS; b++) {
+            if ((value >> b) & 1) typePlanes[b][y] |= (FieldRow)((FieldRow)1 << x);
+        }
+    }
+
+public:
+    explicit BasicTetrisCore(unsigned int seed = std::random_device{}(), PieceRandomizer randomizer = RANDOMIZER_UNIFORM)
+        : pieces(seed, randomizer) {
+        boardVersion = 0;
+        restartGame();
+    }
+
+    // Restarts the piece sequence; takes effect from the next restartGame().
+    void reseed(unsigned int newSeed) {
+        pieces.seed(newSeed);
+    }
+
+    // Changes how pieces are picked from the next draw on, starting a fresh
+    // bag.
+    void setRandomizer(PieceRandomizer randomizer) {
+        pieces.setRandomizer(randomizer);
+    }
+
+    PieceRandomizer getRandomizer() const {
+        return pieces.getRandomizer();
+    }
+
+    // A piece of the given type where it enters the board.
+    static Tetromino spawnPiece(int type) {
+        Tetromino piece;
+        piece.setType(type);
+        piece.x = (int8_t)(Width / 2 + PIECE_TABLE.pieces[type].spawnX);
+        piece.y = (int8_t)(SPAWN_ROW + PIECE_TABLE.pieces[type].spawnY);
+        return piece;
+    }
+
+    void saveState(State& state) const {
+        copyCells(&state.cells[0][0]);
+        state.currentPiece = currentPiece;
+        state.nextPiece = nextPiece;
+        state.score = score;
+        state.level = level;
+        state.linesCleared = linesCleared;
+        state.piecesPlaced = piecesPlaced;
+        state.ticksSinceFall = ticksSinceFall;
+        state.pieces = pieces;
+        state.gameOver = gameOver;
+        state.gamePaused = gamePaused;
+    }
+
+    void loadState(const State& state) {
+        board.clear();
+        memset(typePlanes, 0, sizeof(typePlanes));
+        for (int y = 0; y < Height; y++) {
+            for (int x = 0; x < Width; x++) {
+                if (!state.cells[y][x]) continue;
+                board.setCell(x, y);
+                setCellType(x, y, state.cells[y][x]);
+            }
+        }
+        boardVersion++;
+
+        currentPiece = state.currentPiece;
+        nextPiece = state.nextPiece;
+        score = state.score;
+        level = state.level;
+        linesCleared = state.linesCleared;
+        piecesPlaced = state.piecesPlaced;
+        ticksSinceFall = state.ticksSinceFall;
+        fallTicks = fallTicksForLevel(level);
+        gameOver = state.gameOver;
+        gamePaused = state.gamePaused;
+
+        pieces = state.pieces;
+    }
+
+    void restartGame() {
+        board.clear();
+        memset(typePlanes, 0, sizeof(typePlanes));
+        boardVersion++;
+        gameOver = false;
+        gamePaused = false;
+        score = 0;
+        level = 1;
+        linesCleared = 0;
+        piecesPlaced = 0;
+        ticksSinceFall = 0;
+        fallTicks = fallTicksForLevel(level);
+        nextPiece.setType(drawPieceType());
+        spawnNewPiece();
+    }
+
+    void spawnNewPiece() {
+        currentPiece = spawnPiece(nextPiece.type);
+
+        nextPiece.setType(drawPieceType());
+
+        if (checkCollision(currentPiece, 0, 0)) {
+            gameOver = true;
+        }
+    }
+
+    bool collidesAt(const uint8_t rows[4], int x, int y) const {
+        TRACE_COUNT(collisionChecks);
+        return board.collides(rows, x, y);
+    }
+
+    bool checkCollision(const Tetromino& piece, int dx, int dy) const {
+        return collidesAt(piece.shape().rows, piece.x + dx, piece.y + dy);
+    }
+
+    void placePiece() {
+        TRACE_ZONE("placePiece");
+        for (const CellOffset& cell : currentPiece.shape().cells) {
+            int gridX = currentPiece.x + cell.x;
+            int gridY = currentPiece.y + cell.y;
+
+            if (gridY >= 0) {
+                board.setCell(gridX, gridY);
+                setCellType(gridX, gridY, currentPiece.type + 1);
+            }
+        }
+        piecesPlaced++;
+        boardVersion++;
+
+        int clearedLines = clearLines();
+        updateScore(clearedLines);
+        spawnNewPiece();
+    }
+
+    int clearLines() {
+        TRACE_ZONE("clearLines");
+        int clearedCount = 0;
+
+        for (int y = Height - 1; y >= 0; y--) {
+            if (board.isRowFull(y)) {
+                clearedCount++;
+
+                board.removeRow(y);
+                for (int b = 0; b < TYPE_BITS; b++) {
+                    memmove(&typePlanes[b][1], &typePlanes[b][0], y * sizeof(FieldRow));
+                    typePlanes[b][0] = 0;
+                }
+
+                y++;
+            }
+        }
+
+        return clearedCount;
+    }
+
+    // Ticks between gravity steps: BASE_FALL_TICKS / (1 + (level - 1) / 10),
+    // rounded to the nearest tick with halves rounding up.
+    int fallTicksForLevel(int forLevel) const {
+        int divisor = forLevel + 9;
+        int ticks = (20 * BASE_FALL_TICKS + divisor) / (2 * divisor);
+        return ticks < 1 ? 1 : ticks;
+    }
+
+    void updateScore(int clearedLines) {
+        if (clearedLines > 0) {
+            linesCleared += clearedLines;
+            score += SCORE_VALUES[clearedLines - 1] * level;
+
+            int newLevel = (linesCleared / 10) + 1;
+            if (newLevel > level) {
+                level = newLevel;
+                fallTicks = fallTicksForLevel(level);
+            }
+        }
+    }
+
+    // Rotates clockwise using the first kick in the piece's kick list that
+    // fits. Returns the index of that kick, or -1 if none did.
+    int rotatePiece() {
+        const int rotation = (currentPiece.rotation + 1) & 3;
+        const PieceInfo& info = PIECE_TABLE.pieces[currentPiece.type];
+        const uint8_t* rows = info.rotations[rotation].rows;
+
+        for (int i = 0; i < KICK_COUNT; i++) {
+            const CellOffset& kick = info.kicks[currentPiece.rotation][i];
+            if (!collidesAt(rows, currentPiece.x + kick.x, currentPiece.y + kick.y)) {
+                currentPiece.rotation = (int8_t)rotation;
+                currentPiece.x += kick.x;
+                currentPiece.y += kick.y;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool movePiece(int dx, int dy) {
+        if (checkCollision(currentPiece, dx, dy)) return false;
+        currentPiece.x += dx;
+        currentPiece.y += dy;
+        return true;
+    }
+
+    // Rows the current piece can fall before it lands.
+    int dropDistance() const {
+        const PieceRotation& shape = currentPiece.shape();
+        return board.dropDistance(shape.rows, shape.bottoms, currentPiece.x, currentPiece.y);
+    }
+
+    // Where the current piece would land, for the ghost preview.
+    Tetromino getGhostPiece() const {
+        Tetromino ghost = currentPiece;
+        ghost.y = (int8_t)(ghost.y + dropDistance());
+        return ghost;
+    }
+
+    void hardDrop() {
+        currentPiece.y = (int8_t)(currentPiece.y + dropDistance());
+    }
+
+    // One gravity step: the piece falls a row, or locks if it cannot.
+    void step() {
+        if (!checkCollision(currentPiece, 0, 1)) {
+            currentPiece.y++;
+        } else {
+            placePiece();
+        }
+    }
+
+    // Advances the game by one 1/TICKS_PER_SECOND tick.
+    void tick() {
+        if (gameOver || gamePaused) return;
+
+        if (++ticksSinceFall >= fallTicks) {
+            step();
+            ticksSinceFall = 0;
+        }
+    }
+
+    void togglePause() {
+        gamePaused = !gamePaused;
+    }
+
+    // 0 for an empty cell, otherwise the type + 1 of the piece that locked there.
+    int getCell(int x, int y) const {
+        int value = 0;
+        for (int b = 0; b < TYPE_BITS; b++) {
+            value |= (typePlanes[b][y] >> x & 1) << b;
+        }
+        return value;
+    }
+
+    // Writes the getCell() values as a row-major Width x Height array.
+    void copyCells(uint8_t* out) const {
+        for (int y = 0; y < Height; y++) {
+            for (int x = 0; x < Width; x++) {
+                *out++ = (uint8_t)getCell(x, y);
+            }
+        }
+    }
+
+    // Changes whenever a piece locks, lines clear or the game restarts,
+    // wrapping at 2^16, far more changes than happen between two frames.
+    uint32_t getBoardVersion() const {
+        return boardVersion;
+    }
+
+    const Board& getBoard() const {
+        return board;
+    }
+
+    const Tetromino& getCurrentPiece() const {
+        return currentPiece;
+    }
+
+    const Tetromino& getNextPiece() const {
+        return nextPiece;
+    }
+
+    bool isGameOver() const {
+        return gameOver;
+    }
+
+    bool isPaused() const {
+        return gamePaused;
+    }
+
+    int getScore() const {
+        return score;
+    }
+
+    int getLevel() const {
+        return level;
+    }
+
+    int getLines() const {
+        return linesCleared;
+    }
+
+    int getPiecesPlaced() const {
+        return piecesPlaced;
+    }
+
+    // Ticks since the last gravity step, and between steps at this level.
+    int getTicksSinceFall() const {
+        return ticksSinceFall;
+    }
+
+    int getFallTicks() const {
+        return fallTicks;
+    }
+};
+
+typedef BasicTetrisCore<15, 20> TetrisCore;
+typedef TetrisCore::State TetrisState;
+
+// The standard 10x20 field, and the 10x40 field with a 20-row hidden buffer.
+typedef BasicTetrisCore<10, 20> StandardTetrisCore;
+typedef BasicTetrisCore<10, 40, 20> TallTetrisCore;
+
+// The sizes README.md quotes, exact so that a new field or a padding gap
+// shows up here.
+static_assert(sizeof(TetrisCore) == 232, "TetrisCore changed size");
+static_assert(sizeof(TallTetrisCore) == 392, "TallTetrisCore changed size");
+
+#endif
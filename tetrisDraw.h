@@ -0,0 +1,44 @@
+#ifndef TETRIS_DRAW_H
+#define TETRIS_DRAW_H
+
+// CPU-side draw data. Everything on screen is an axis-aligned colored
+// rectangle; a frame is built as a list of them in painter's order and
+// handed to a backend in as few draw calls as it can manage.
+
+#include <cstddef>
+#include <vector>
+
+struct QuadInstance {
+    float x, y;
+    float w, h;
+    float r, g, b;
+    float brightness;
+};
+
+class QuadBatch {
+private:
+    std::vector<QuadInstance> quads;
+
+public:
+    void rect(float x, float y, float w, float h, const float color[3], float brightness = 1.0f) {
+        quads.push_back({x, y, w, h, color[0], color[1], color[2], brightness});
+    }
+
+    void clear() {
+        quads.clear();
+    }
+
+    bool empty() const {
+        return quads.empty();
+    }
+
+    size_t size() const {
+        return quads.size();
+    }
+
+    const QuadInstance* data() const {
+        return quads.data();
+    }
+};
+
+#endif
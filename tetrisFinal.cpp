@@ -1,1149 +1,706 @@
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
+#include "tetrisCore.h"
+#include "tetrisDraw.h"
+#include "tetrisFont.h"
+#include "tetrisGame.h"
+#include "tetrisInput.h"
+#include "tetrisProfile.h"
+#include "tetrisReplay.h"
+#include "tetrisScene.h"
+#include "tetrisTrace.h"
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <random>
+#include <cstdlib>
 #include <cstring>
-#include <sstream>
-#include <iomanip>
 #include <map>
 #include <array>
+#include <cstddef>
 
 using namespace std;
 
-const int GRID_WIDTH = 15;
-const int GRID_HEIGHT = 20;
-const int WINDOW_WIDTH = 1000;
-const int WINDOW_HEIGHT = 800;
-const float BLOCK_SIZE = 30.0f;
-const float GRID_OFFSET_X = 50.0f;
-const float GRID_OFFSET_Y = 50.0f;
-const float BORDER_WIDTH = 3.0f;
-
-const int TETROMINO_SHAPES[7][4][4] = {
-    {{0,0,0,0}, {1,1,1,1}, {0,0,0,0}, {0,0,0,0}},
-    {{0,0,0,0}, {0,1,1,0}, {0,1,1,0}, {0,0,0,0}},
-    {{0,0,0,0}, {0,1,0,0}, {1,1,1,0}, {0,0,0,0}},
-    {{0,0,0,0}, {0,1,1,0}, {1,1,0,0}, {0,0,0,0}},
-    {{0,0,0,0}, {1,1,0,0}, {0,1,1,0}, {0,0,0,0}},
-    {{0,0,0,0}, {1,0,0,0}, {1,1,1,0}, {0,0,0,0}},
-    {{0,0,0,0}, {0,0,1,0}, {1,1,1,0}, {0,0,0,0}}
-};
-
-const float TETROMINO_COLORS[7][3] = {
-    {0.0f, 1.0f, 1.0f},
-    {1.0f, 1.0f, 0.0f},
-    {0.5f, 0.0f, 0.5f},
-    {0.0f, 1.0f, 0.0f},
-    {1.0f, 0.0f, 0.0f},
-    {0.0f, 0.0f, 1.0f},
-    {1.0f, 0.5f, 0.0f}
-};
-
-const int SCORE_VALUES[4] = {40, 100, 300, 1200};
-
-struct Tetromino {
-    int shape[4][4];
-    float color[3];
-    int x, y;
-    int type;
-    
-    Tetromino() {
-        memset(shape, 0, sizeof(shape));
-        memset(color, 0, sizeof(color));
-        x = y = type = 0;
-    }
+// Draw calls issued by all renderers, so a frame's total can be checked.
+struct DrawStats {
+    int drawCalls = 0;
     
-    void setType(int newType) {
-        type = newType;
-        memcpy(shape, TETROMINO_SHAPES[newType], sizeof(shape));
-        memcpy(color, TETROMINO_COLORS[newType], sizeof(color));
+    void beginFrame() {
+        drawCalls = 0;
     }
 };
 
-class TetrisGame {
-private:
-    int grid[GRID_HEIGHT][GRID_WIDTH];
-    float gridColors[GRID_HEIGHT][GRID_WIDTH][3];
-    Tetromino currentPiece;
-    Tetromino nextPiece;
-    double lastFallTime;
-    double fallSpeed;
-    double baseFallSpeed;
-    bool gameOver;
-    bool gamePaused;
-    bool showHelp;
-    int score;
-    int level;
-    int linesCleared;
-    
-    mt19937 rng;
-    uniform_int_distribution<int> shapeDist;
+GLuint compileProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+    glCompileShader(vertexShader);
     
-    GLuint VAO, VBO;
-    GLuint shaderProgram;
+    int success;
+    char infoLog[512];
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+        cout << "Vertex shader compilation failed: " << infoLog << endl;
+    }
     
-    bool restartButtonHovered;
-    bool helpButtonHovered;
-    bool closeHelpButtonHovered;
-    float restartButtonX, restartButtonY, restartButtonW, restartButtonH;
-    float helpButtonX, helpButtonY, helpButtonW, helpButtonH;
-    float closeHelpButtonX, closeHelpButtonY, closeHelpButtonW, closeHelpButtonH;
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+    glCompileShader(fragmentShader);
     
-    bool keyStates[GLFW_KEY_LAST] = {false};
-    bool prevKeyStates[GLFW_KEY_LAST] = {false};
-    bool mousePressed = false;
-    bool prevMousePressed = false;
-    double mouseX = 0, mouseY = 0;
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+        cout << "Fragment shader compilation failed: " << infoLog << endl;
+    }
     
-    map<char, array<array<int, 5>, 7>> fontData;
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
     
-public:
-    TetrisGame() : rng(random_device{}()), shapeDist(0, 6) {
-        memset(grid, 0, sizeof(grid));
-        memset(gridColors, 0, sizeof(gridColors));
-        
-        lastFallTime = 0.0;
-        baseFallSpeed = 1.0;
-        fallSpeed = baseFallSpeed;
-        gameOver = false;
-        gamePaused = false;
-        showHelp = false;
-        score = 0;
-        level = 1;
-        linesCleared = 0;
-        
-        restartButtonHovered = false;
-        helpButtonHovered = false;
-        closeHelpButtonHovered = false;
-        restartButtonX = WINDOW_WIDTH - 180;
-        restartButtonY = 400;
-        restartButtonW = 120;
-        restartButtonH = 40;
-        
-        helpButtonX = WINDOW_WIDTH - 180;
-        helpButtonY = 500;
-        helpButtonW = 120;
-        helpButtonH = 40;
-
-        closeHelpButtonX = WINDOW_WIDTH / 2 - 60;
-        closeHelpButtonY = WINDOW_HEIGHT / 2 + 150;
-        closeHelpButtonW = 120;
-        closeHelpButtonH = 40;
-        
-        initializeFont();
-        
-        nextPiece.setType(shapeDist(rng));
-        spawnNewPiece();
-        setupOpenGL();
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        cout << "Shader program linking failed: " << infoLog << endl;
     }
     
-    void initializeFont() {
-        fontData['0'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['1'] = {{
-            {0,0,1,0,0},
-            {0,1,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,1,1,1,0}
-        }};
-        
-        fontData['2'] = {{
-            {1,1,1,1,1},
-            {0,0,0,0,1},
-            {0,0,0,0,1},
-            {1,1,1,1,1},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['3'] = {{
-            {1,1,1,1,1},
-            {0,0,0,0,1},
-            {0,0,0,0,1},
-            {1,1,1,1,1},
-            {0,0,0,0,1},
-            {0,0,0,0,1},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['4'] = {{
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1},
-            {0,0,0,0,1},
-            {0,0,0,0,1},
-            {0,0,0,0,1}
-        }};
-        
-        fontData['5'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,1,1,1,1},
-            {0,0,0,0,1},
-            {0,0,0,0,1},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['6'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,1,1,1,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['7'] = {{
-            {1,1,1,1,1},
-            {0,0,0,0,1},
-            {0,0,0,0,1},
-            {0,0,0,1,0},
-            {0,0,1,0,0},
-            {0,1,0,0,0},
-            {1,0,0,0,0}
-        }};
-        
-        fontData['8'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['9'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1},
-            {0,0,0,0,1},
-            {0,0,0,0,1},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['S'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,1,1,1,1},
-            {0,0,0,0,1},
-            {0,0,0,0,1},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['C'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['O'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['R'] = {{
-            {1,1,1,1,0},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,0},
-            {1,0,1,0,0},
-            {1,0,0,1,0},
-            {1,0,0,0,1}
-        }};
-        
-        fontData['E'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,1,1,1,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['L'] = {{
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,1,1,1,1}
-        }};
-        
-        fontData['V'] = {{
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {0,1,0,1,0},
-            {0,0,1,0,0}
-        }};
-        
-        fontData['N'] = {{
-            {1,0,0,0,1},
-            {1,1,0,0,1},
-            {1,0,1,0,1},
-            {1,0,0,1,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1}
-        }};
-        
-        fontData['X'] = {{
-            {1,0,0,0,1},
-            {0,1,0,1,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,1,0,1,0},
-            {1,0,0,0,1}
-        }};
-        
-        fontData['T'] = {{
-            {1,1,1,1,1},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0}
-        }};
-        
-        fontData[':'] = {{
-            {0,0,0,0,0},
-            {0,0,1,0,0},
-            {0,0,0,0,0},
-            {0,0,0,0,0},
-            {0,0,0,0,0},
-            {0,0,1,0,0},
-            {0,0,0,0,0}
-        }};
-        
-        fontData[' '] = {{
-            {0,0,0,0,0},
-            {0,0,0,0,0},
-            {0,0,0,0,0},
-            {0,0,0,0,0},
-            {0,0,0,0,0},
-            {0,0,0,0,0},
-            {0,0,0,0,0}
-        }};
-        
-        fontData['P'] = {{
-            {1,1,1,1,0},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0}
-        }};
-        
-        fontData['A'] = {{
-            {0,1,1,1,0},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1}
-        }};
-        
-        fontData['U'] = {{
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1}
-        }};
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return program;
+}
+
+const float UNIT_QUAD_VERTICES[] = {
+    0.0f, 0.0f,
+    1.0f, 0.0f,
+    1.0f, 1.0f,
+    0.0f, 0.0f,
+    1.0f, 1.0f,
+    0.0f, 1.0f
+};
+
+// Quads kept in their own instance buffer on the GPU, drawn at an offset and
+// tinted with one call. Instance positions are relative to the mesh origin.
+struct QuadMesh {
+    GLuint VAO = 0;
+    GLuint instanceVBO = 0;
+    GLsizei count = 0;
+};
+
+// Draws every rectangle of a frame from one instance buffer. Callers queue
+// quads with rect() and flush() uploads them and issues a single instanced
+// draw, so painter's order is kept without a draw call per quad. Meshes that
+// do not change between frames can be uploaded once with createMesh().
+class QuadRenderer {
+private:
+    GLuint VAO, VBO, instanceVBO;
+    GLuint shaderProgram;
+    GLint viewportLoc, offsetLoc, tintLoc;
+    size_t instanceCapacity;
+    QuadBatch batch;
+    DrawStats* stats;
+
+public:
+    QuadRenderer() : VAO(0), VBO(0), instanceVBO(0), shaderProgram(0), viewportLoc(-1), offsetLoc(-1),
+                     tintLoc(-1), instanceCapacity(0), stats(NULL) {}
+    
+    void setupInstanceAttributes(GLuint vao, GLuint instanceBuffer) {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
         
-        fontData['G'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,0,1,1,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1}
-        }};
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (void*)offsetof(QuadInstance, x));
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (void*)offsetof(QuadInstance, r));
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
         
-        fontData['M'] = {{
-            {1,0,0,0,1},
-            {1,1,0,1,1},
-            {1,0,1,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1}
-        }};
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    void init(DrawStats* drawStats) {
+        stats = drawStats;
+
+        const char* vertexShaderSource = R"(
+            #version 330 core
+            layout (location = 0) in vec2 aPos;
+            layout (location = 1) in vec4 aRect;
+            layout (location = 2) in vec4 aColor;
+            uniform vec2 uViewport;
+            uniform vec2 uOffset;
+            uniform vec3 uTint;
+            out vec3 vColor;
+            void main() {
+                vec2 pos = (aPos * aRect.zw) + aRect.xy + uOffset;
+                gl_Position = vec4(pos.x * 2.0 / uViewport.x - 1.0, 1.0 - pos.y * 2.0 / uViewport.y, 0.0, 1.0);
+                vColor = aColor.rgb * aColor.a * uTint;
+            }
+        )";
         
-        fontData['I'] = {{
-            {1,1,1,1,1},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {1,1,1,1,1}
-        }};
+        const char* fragmentShaderSource = R"(
+            #version 330 core
+            in vec3 vColor;
+            out vec4 FragColor;
+            void main() {
+                FragColor = vec4(vColor, 1.0);
+            }
+        )";
         
-        fontData['H'] = {{
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1}
-        }};
+        shaderProgram = compileProgram(vertexShaderSource, fragmentShaderSource);
+        viewportLoc = glGetUniformLocation(shaderProgram, "uViewport");
+        offsetLoc = glGetUniformLocation(shaderProgram, "uOffset");
+        tintLoc = glGetUniformLocation(shaderProgram, "uTint");
         
-        fontData['W'] = {{
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,1,0,1},
-            {1,0,1,0,1},
-            {1,1,0,1,1},
-            {1,0,0,0,1}
-        }};
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &instanceVBO);
         
-        fontData['D'] = {{
-            {1,1,1,1,0},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {1,1,1,1,0}
-        }};
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(UNIT_QUAD_VERTICES), UNIT_QUAD_VERTICES, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
         
-        fontData['F'] = {{
-            {1,1,1,1,1},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,1,1,1,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0},
-            {1,0,0,0,0}
-        }};
+        setupInstanceAttributes(VAO, instanceVBO);
+    }
+    
+    void rect(float x, float y, float w, float h, const float color[3], float brightness = 1.0f) {
+        batch.rect(x, y, w, h, color, brightness);
+    }
+    
+    // For text that changes every frame and is not worth caching as a mesh.
+    void text(const string& text, float x, float y, const float color[3], float pixelSize) {
+        buildTextQuads(batch, text, x, y, color, pixelSize);
+    }
+    
+    void flush() {
+        TRACE_ZONE("QuadRenderer::flush");
+        if (batch.empty()) return;
         
-        fontData['Y'] = {{
-            {1,0,0,0,1},
-            {1,0,0,0,1},
-            {0,1,0,1,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0},
-            {0,0,1,0,0}
-        }};
+        glUseProgram(shaderProgram);
+        glUniform2f(viewportLoc, (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT);
+        glUniform2f(offsetLoc, 0.0f, 0.0f);
+        glUniform3f(tintLoc, 1.0f, 1.0f, 1.0f);
         
-        fontData['K'] = {{
-            {1,0,0,0,1},
-            {1,0,0,1,0},
-            {1,0,1,0,0},
-            {1,1,0,0,0},
-            {1,0,1,0,0},
-            {1,0,0,1,0},
-            {1,0,0,0,1}
-        }};
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (batch.size() > instanceCapacity) {
+            instanceCapacity = batch.size() * 2;
+        }
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(QuadInstance), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, batch.size() * sizeof(QuadInstance), batch.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
         
-        fontData['-'] = {{
-            {0,0,0,0,0},
-            {0,0,0,0,0},
-            {0,0,0,0,0},
-            {1,1,1,1,1},
-            {0,0,0,0,0},
-            {0,0,0,0,0},
-            {0,0,0,0,0}
-        }};
+        glBindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)batch.size());
+        stats->drawCalls++;
         
-        fontData['/'] = {{
-            {0,0,0,0,1},
-            {0,0,0,1,0},
-            {0,0,1,0,0},
-            {0,1,0,0,0},
-            {1,0,0,0,0},
-            {0,0,0,0,0},
-            {0,0,0,0,0}
-        }};
+        batch.clear();
     }
     
-    void drawCharacter(char c, float x, float y, const float color[3], float pixelSize = 3.0f) {
-        if (fontData.find(c) == fontData.end()) return;
+    QuadMesh createMesh(const QuadBatch& quads) {
+        QuadMesh mesh;
+        mesh.count = (GLsizei)quads.size();
+        if (mesh.count == 0) return mesh;
         
-        auto& charData = fontData[c];
-        for (int row = 0; row < 7; row++) {
-            for (int col = 0; col < 5; col++) {
-                if (charData[row][col]) {
-                    drawPixel(x + col * pixelSize, y + row * pixelSize, pixelSize, color);
-                }
-            }
-        }
+        glGenVertexArrays(1, &mesh.VAO);
+        glGenBuffers(1, &mesh.instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, quads.size() * sizeof(QuadInstance), quads.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        setupInstanceAttributes(mesh.VAO, mesh.instanceVBO);
+        return mesh;
     }
     
-    void drawText(const string& text, float x, float y, const float color[3], float pixelSize = 3.0f) {
-        float currentX = x;
-        for (char c : text) {
-            drawCharacter(c, currentX, y, color, pixelSize);
-            currentX += 6 * pixelSize;
-        }
+    void destroyMesh(QuadMesh& mesh) {
+        if (mesh.VAO) glDeleteVertexArrays(1, &mesh.VAO);
+        if (mesh.instanceVBO) glDeleteBuffers(1, &mesh.instanceVBO);
+        mesh = QuadMesh();
     }
     
-    void drawPixel(float x, float y, float size, const float color[3]) {
-        glUseProgram(shaderProgram);
-        
-        GLint translationLoc = glGetUniformLocation(shaderProgram, "uTranslation");
-        GLint scaleLoc = glGetUniformLocation(shaderProgram, "uScale");
-        GLint colorLoc = glGetUniformLocation(shaderProgram, "uColor");
-        GLint brightnessLoc = glGetUniformLocation(shaderProgram, "uBrightness");
+    // Flushes queued quads first so the mesh lands on top of them.
+    void drawMesh(const QuadMesh& mesh, float x, float y, const float tint[3]) {
+        TRACE_ZONE("QuadRenderer::drawMesh");
+        if (mesh.count == 0) return;
+        flush();
         
-        glUniform2f(translationLoc, x, y);
-        glUniform2f(scaleLoc, size, size);
-        glUniform3f(colorLoc, color[0], color[1], color[2]);
-        glUniform1f(brightnessLoc, 1.0f);
+        glUseProgram(shaderProgram);
+        glUniform2f(viewportLoc, (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT);
+        glUniform2f(offsetLoc, x, y);
+        glUniform3f(tintLoc, tint[0], tint[1], tint[2]);
         
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(mesh.VAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, mesh.count);
+        stats->drawCalls++;
+    }
+};
+
+// Parts of the frame that change rarely are rendered once into their own
+// offscreen framebuffer and copied to the window each frame. A layer is only
+// re-rendered after invalidate(); getRenderCount() says how often that
+// happened, so idle frames can be checked to re-render nothing.
+class LayerCache {
+private:
+    GLuint framebuffers[LAYER_COUNT];
+    GLuint colorBuffers[LAYER_COUNT];
+    bool valid[LAYER_COUNT];
+    int renderCounts[LAYER_COUNT];
+
+public:
+    LayerCache() {
+        for (int i = 0; i < LAYER_COUNT; i++) {
+            framebuffers[i] = colorBuffers[i] = 0;
+            valid[i] = false;
+            renderCounts[i] = 0;
+        }
     }
     
-    void drawButton(float x, float y, float w, float h, const string& text, bool hovered, bool pressed = false) {
-        float bgColor[3];
-        if (text == "RESTART") {
-            if (pressed) {
-                bgColor[0] = 0.1f; bgColor[1] = 0.4f; bgColor[2] = 0.1f;
-            } else if (hovered) {
-                bgColor[0] = 0.2f; bgColor[1] = 0.8f; bgColor[2] = 0.2f;
-            } else {
-                bgColor[0] = 0.1f; bgColor[1] = 0.6f; bgColor[2] = 0.1f;
-            }
-        } else if (text == "HELP") {
-            if (pressed) {
-                bgColor[0] = 0.6f; bgColor[1] = 0.6f; bgColor[2] = 0.0f;
-            } else if (hovered) {
-                bgColor[0] = 1.0f; bgColor[1] = 1.0f; bgColor[2] = 0.3f;
-            } else {
-                bgColor[0] = 0.8f; bgColor[1] = 0.8f; bgColor[2] = 0.0f;
-            }
-        } else {
-            if (pressed) {
-                bgColor[0] = 0.2f; bgColor[1] = 0.6f; bgColor[2] = 0.2f;
-            } else if (hovered) {
-                bgColor[0] = 0.3f; bgColor[1] = 0.7f; bgColor[2] = 0.3f;
-            } else {
-                bgColor[0] = 0.4f; bgColor[1] = 0.4f; bgColor[2] = 0.4f;
+    void init() {
+        glGenFramebuffers(LAYER_COUNT, framebuffers);
+        glGenRenderbuffers(LAYER_COUNT, colorBuffers);
+        for (int i = 0; i < LAYER_COUNT; i++) {
+            glBindRenderbuffer(GL_RENDERBUFFER, colorBuffers[i]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WINDOW_WIDTH, WINDOW_HEIGHT);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffers[i]);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                cout << "Layer framebuffer " << i << " is incomplete" << endl;
             }
         }
-        
-        glUseProgram(shaderProgram);
-        GLint translationLoc = glGetUniformLocation(shaderProgram, "uTranslation");
-        GLint scaleLoc = glGetUniformLocation(shaderProgram, "uScale");
-        GLint colorLoc = glGetUniformLocation(shaderProgram, "uColor");
-        GLint brightnessLoc = glGetUniformLocation(shaderProgram, "uBrightness");
-        
-        glUniform2f(translationLoc, x, y);
-        glUniform2f(scaleLoc, w, h);
-        glUniform3f(colorLoc, bgColor[0], bgColor[1], bgColor[2]);
-        glUniform1f(brightnessLoc, 1.0f);
-        
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        float textColor[3] = {1.0f, 1.0f, 1.0f};
-        float textX = x + (w - text.length() * 6 * 2.5f) / 2;
-        float textY = y + (h - 7 * 2.5f) / 2;
-        drawText(text, textX, textY, textColor, 2.5f);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
     
-    void drawBorder() {
-        float borderColor[3] = {0.8f, 0.8f, 0.8f};
-        
-        glUseProgram(shaderProgram);
-        GLint translationLoc = glGetUniformLocation(shaderProgram, "uTranslation");
-        GLint scaleLoc = glGetUniformLocation(shaderProgram, "uScale");
-        GLint colorLoc = glGetUniformLocation(shaderProgram, "uColor");
-        GLint brightnessLoc = glGetUniformLocation(shaderProgram, "uBrightness");
-        
-        glUniform3f(colorLoc, borderColor[0], borderColor[1], borderColor[2]);
-        glUniform1f(brightnessLoc, 1.0f);
-        
-        float gridAreaX = GRID_OFFSET_X;
-        float gridAreaY = GRID_OFFSET_Y;
-        float gridAreaW = GRID_WIDTH * BLOCK_SIZE;
-        float gridAreaH = GRID_HEIGHT * BLOCK_SIZE;
-        
-        glUniform2f(translationLoc, gridAreaX - BORDER_WIDTH, gridAreaY - BORDER_WIDTH);
-        glUniform2f(scaleLoc, gridAreaW + 2 * BORDER_WIDTH, BORDER_WIDTH);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        glUniform2f(translationLoc, gridAreaX - BORDER_WIDTH, gridAreaY + gridAreaH);
-        glUniform2f(scaleLoc, gridAreaW + 2 * BORDER_WIDTH, BORDER_WIDTH);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        glUniform2f(translationLoc, gridAreaX - BORDER_WIDTH, gridAreaY);
-        glUniform2f(scaleLoc, BORDER_WIDTH, gridAreaH);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        glUniform2f(translationLoc, gridAreaX + gridAreaW, gridAreaY);
-        glUniform2f(scaleLoc, BORDER_WIDTH, gridAreaH);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+    void invalidate(Layer layer) {
+        valid[layer] = false;
     }
     
-    void drawHelpOverlay() {
-        if (!showHelp) return;
-        
-        float overlayColor[3] = {0.0f, 0.0f, 0.0f};
-        glUseProgram(shaderProgram);
-        GLint translationLoc = glGetUniformLocation(shaderProgram, "uTranslation");
-        GLint scaleLoc = glGetUniformLocation(shaderProgram, "uScale");
-        GLint colorLoc = glGetUniformLocation(shaderProgram, "uColor");
-        GLint brightnessLoc = glGetUniformLocation(shaderProgram, "uBrightness");
-        
-        glUniform2f(translationLoc, 0, 0);
-        glUniform2f(scaleLoc, WINDOW_WIDTH, WINDOW_HEIGHT);
-        glUniform3f(colorLoc, overlayColor[0], overlayColor[1], overlayColor[2]);
-        glUniform1f(brightnessLoc, 0.7f);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        float panelColor[3] = {0.2f, 0.2f, 0.3f};
-        float panelX = WINDOW_WIDTH / 2 - 200;
-        float panelY = WINDOW_HEIGHT / 2 - 200;
-        float panelW = 400;
-        float panelH = 400;
-        
-        glUniform2f(translationLoc, panelX, panelY);
-        glUniform2f(scaleLoc, panelW, panelH);
-        glUniform3f(colorLoc, panelColor[0], panelColor[1], panelColor[2]);
-        glUniform1f(brightnessLoc, 1.0f);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        float textColor[3] = {1.0f, 1.0f, 1.0f};
-        float titleColor[3] = {0.0f, 1.0f, 1.0f};
-        float textX = panelX + 20;
-        float textY = panelY + 20;
-        
-        drawText("HOW TO PLAY TETRIS", textX, textY, titleColor, 2.5f);
-        
-        drawText("CONTROLS:", textX, textY + 40, textColor, 2.0f);
-        drawText("A/D OR LEFT/RIGHT - MOVE", textX, textY + 60, textColor, 1.8f);
-        drawText("W OR UP - ROTATE PIECE", textX, textY + 80, textColor, 1.8f);
-        drawText("S OR DOWN - SOFT DROP", textX, textY + 100, textColor, 1.8f);
-        drawText("SPACE - HARD DROP", textX, textY + 120, textColor, 1.8f);
-        drawText("P - PAUSE/RESUME", textX, textY + 140, textColor, 1.8f);
-        drawText("R - RESTART GAME", textX, textY + 160, textColor, 1.8f);
-        
-        drawText("OBJECTIVE:", textX, textY + 190, textColor, 2.0f);
-        drawText("FILL COMPLETE ROWS TO", textX, textY + 210, textColor, 1.8f);
-        drawText("CLEAR THEM AND SCORE", textX, textY + 230, textColor, 1.8f);
-        drawText("POINTS", textX, textY + 250, textColor, 1.8f);
-        
-        drawText("SCORING:", textX, textY + 280, textColor, 2.0f);
-        drawText("1 LINE = 40 X LEVEL", textX, textY + 300, textColor, 1.8f);
-        drawText("2 LINES = 100 X LEVEL", textX, textY + 320, textColor, 1.8f);
-        drawText("3 LINES = 300 X LEVEL", textX, textY + 340, textColor, 1.8f);
-        drawText("4 LINES = 1200 X LEVEL", textX, textY + 360, textColor, 1.8f);
-        
-        float closeColor[3] = {1.0f, 1.0f, 0.0f};
-        drawText("CLICK CLOSE BUTTON TO RETURN", textX, textY + 380, closeColor, 1.5f);
+    // Returns true, with the layer bound and cleared, if it needs drawing.
+    // Draw into it and call end().
+    bool begin(Layer layer) {
+        if (valid[layer]) return false;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[layer]);
+        glClearColor(CLEAR_COLOR[0], CLEAR_COLOR[1], CLEAR_COLOR[2], 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        return true;
+    }
+    
+    void end(Layer layer) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        valid[layer] = true;
+        renderCounts[layer]++;
+    }
+    
+    // Copies a window-space rectangle (top-left origin) of the layer to the window.
+    void composite(Layer layer, float x, float y, float w, float h) {
+        TRACE_ZONE("LayerCache::composite");
+        GLint x0 = (GLint)x;
+        GLint y0 = WINDOW_HEIGHT - (GLint)(y + h);
+        GLint x1 = (GLint)(x + w);
+        GLint y1 = WINDOW_HEIGHT - (GLint)y;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[layer]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(x0, y0, x1, y1, x0, y0, x1, y1, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    
+    int getRenderCount(Layer layer) const {
+        return renderCounts[layer];
+    }
+};
+
+// Text meshes keyed by (string, pixel size), built from GLYPH_ATLAS the first
+// time a string is drawn and reused until 120 text-drawing frames pass
+// without it. Static labels are built once; a changing value such as the
+// score only builds a new mesh when its text changes.
+class TextCache {
+private:
+    struct Entry {
+        QuadMesh mesh;
+        unsigned long lastUsedFrame;
+    };
+    
+    static const unsigned long EVICT_AFTER_FRAMES = 120;
+    
+    map<pair<string, float>, Entry> entries;
+    QuadRenderer* renderer;
+    unsigned long frame;
+    bool usedThisFrame;
 
-        drawButton(closeHelpButtonX, closeHelpButtonY, closeHelpButtonW, closeHelpButtonH, 
-                  "CLOSE", closeHelpButtonHovered);
+public:
+    TextCache() : renderer(NULL), frame(0), usedThisFrame(false) {}
+    
+    void init(QuadRenderer* quadRenderer) {
+        renderer = quadRenderer;
+    }
+    
+    void draw(const string& text, float x, float y, const float color[3], float pixelSize) {
+        TRACE_ZONE("TextCache::draw");
+        auto it = entries.find(make_pair(text, pixelSize));
+        if (it == entries.end()) {
+            const float white[3] = {1.0f, 1.0f, 1.0f};
+            QuadBatch quads;
+            buildTextQuads(quads, text, 0.0f, 0.0f, white, pixelSize);
+            Entry entry;
+            entry.mesh = renderer->createMesh(quads);
+            it = entries.emplace(make_pair(text, pixelSize), entry).first;
+        }
+        it->second.lastUsedFrame = frame;
+        usedThisFrame = true;
+        renderer->drawMesh(it->second.mesh, x, y, color);
     }
     
-    void setupOpenGL() {
+    // Only frames that drew text count towards eviction, so meshes survive
+    // while cached layers keep text from being redrawn.
+    void endFrame() {
+        if (!usedThisFrame) return;
+        usedThisFrame = false;
+
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (frame - it->second.lastUsedFrame > EVICT_AFTER_FRAMES) {
+                renderer->destroyMesh(it->second.mesh);
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        frame++;
+    }
+};
+
+// Draws the playfield, empty backdrop and locked blocks, as one quad into
+// the cached board layer; the falling piece and its ghost go over it each
+// frame as ordinary rectangles. The board is an R8UI texture of cell types
+// that is only re-uploaded when the core's board version changes, and
+// reallocated when the board size does; the fragment shader picks each
+// pixel's cell and looks its color up in a palette.
+class BoardRenderer {
+private:
+    GLuint VAO, VBO;
+    GLuint shaderProgram;
+    GLuint cellTexture;
+    GLint viewportLoc, originLoc, sizeLoc;
+    const uint8_t* uploadedCells;
+    unsigned int uploadedVersion;
+    int textureColumns, textureRows;
+    DrawStats* stats;
+
+public:
+    BoardRenderer() : VAO(0), VBO(0), shaderProgram(0), cellTexture(0), viewportLoc(-1), originLoc(-1), sizeLoc(-1),
+                      uploadedCells(NULL), uploadedVersion(0), textureColumns(0), textureRows(0), stats(NULL) {}
+
+    void init(DrawStats* drawStats) {
+        stats = drawStats;
+        
         const char* vertexShaderSource = R"(
             #version 330 core
             layout (location = 0) in vec2 aPos;
-            uniform vec2 uTranslation;
-            uniform vec2 uScale;
+            uniform vec2 uViewport;
+            uniform vec2 uOrigin;
+            uniform vec2 uSize;
             void main() {
-                vec2 pos = (aPos * uScale) + uTranslation;
-                gl_Position = vec4(pos.x * 2.0 / 1000.0 - 1.0, 1.0 - pos.y * 2.0 / 800.0, 0.0, 1.0);
+                vec2 pos = aPos * uSize + uOrigin;
+                gl_Position = vec4(pos.x * 2.0 / uViewport.x - 1.0, 1.0 - pos.y * 2.0 / uViewport.y, 0.0, 1.0);
             }
         )";
         
         const char* fragmentShaderSource = R"(
             #version 330 core
             out vec4 FragColor;
-            uniform vec3 uColor;
-            uniform float uBrightness;
+            uniform usampler2D uCells;
+            uniform vec2 uViewport;
+            uniform vec2 uOrigin;
+            uniform float uBlockSize;
+            uniform vec3 uPalette[8];
             void main() {
-                FragColor = vec4(uColor * uBrightness, 1.0);
+                vec2 local = vec2(gl_FragCoord.x, uViewport.y - gl_FragCoord.y) - uOrigin;
+                vec2 inCell = mod(local, uBlockSize);
+                if (inCell.x >= uBlockSize - 1.0 || inCell.y >= uBlockSize - 1.0) discard;
+                ivec2 cell = ivec2(floor(local / uBlockSize));
+                int type = int(texelFetch(uCells, cell, 0).r);
+                FragColor = vec4(uPalette[type], 1.0);
             }
         )";
         
-        GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-        glCompileShader(vertexShader);
+        shaderProgram = compileProgram(vertexShaderSource, fragmentShaderSource);
+        viewportLoc = glGetUniformLocation(shaderProgram, "uViewport");
+        originLoc = glGetUniformLocation(shaderProgram, "uOrigin");
+        sizeLoc = glGetUniformLocation(shaderProgram, "uSize");
         
-        int success;
-        char infoLog[512];
-        glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-            cout << "Vertex shader compilation failed: " << infoLog << endl;
+        float palette[8][3];
+        for (int c = 0; c < 3; c++) {
+            palette[0][c] = GRID_BACKGROUND_COLOR[c] * GRID_BACKGROUND_BRIGHTNESS;
         }
-        
-        GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-        glCompileShader(fragmentShader);
-        
-        glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-            cout << "Fragment shader compilation failed: " << infoLog << endl;
-        }
-        
-        shaderProgram = glCreateProgram();
-        glAttachShader(shaderProgram, vertexShader);
-        glAttachShader(shaderProgram, fragmentShader);
-        glLinkProgram(shaderProgram);
-        
-        glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-            cout << "Shader program linking failed: " << infoLog << endl;
+        for (int type = 0; type < PIECE_TYPES; type++) {
+            memcpy(palette[type + 1], TETROMINO_COLORS[type], sizeof(palette[type + 1]));
         }
         
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-        
-        float vertices[] = {
-            0.0f, 0.0f,
-            1.0f, 0.0f,
-            1.0f, 1.0f,
-            0.0f, 0.0f,
-            1.0f, 1.0f,
-            0.0f, 1.0f
-        };
+        glUseProgram(shaderProgram);
+        glUniform1i(glGetUniformLocation(shaderProgram, "uCells"), 0);
+        glUniform1f(glGetUniformLocation(shaderProgram, "uBlockSize"), BLOCK_SIZE);
+        glUniform3fv(glGetUniformLocation(shaderProgram, "uPalette"), 8, &palette[0][0]);
+        
+        glGenTextures(1, &cellTexture);
+        glBindTexture(GL_TEXTURE_2D, cellTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
         
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
-        
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        
+        glBufferData(GL_ARRAY_BUFFER, sizeof(UNIT_QUAD_VERTICES), UNIT_QUAD_VERTICES, GL_STATIC_DRAW);
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
-        
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
     }
     
-    void spawnNewPiece() {
-        currentPiece = nextPiece;
-        currentPiece.x = GRID_WIDTH / 2 - 2;
-        currentPiece.y = 0;
+    // cells is columns x rows of cell types, row-major, and version the
+    // board version they were read at.
+    void draw(const uint8_t* cells, int columns, int rows, unsigned int version) {
+        TRACE_ZONE("BoardRenderer::draw");
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, cellTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (columns != textureColumns || rows != textureRows) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, columns, rows, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, cells);
+            textureColumns = columns;
+            textureRows = rows;
+        } else if (cells != uploadedCells || version != uploadedVersion) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, columns, rows, GL_RED_INTEGER, GL_UNSIGNED_BYTE, cells);
+        }
+        uploadedCells = cells;
+        uploadedVersion = version;
         
-        nextPiece.setType(shapeDist(rng));
+        glUseProgram(shaderProgram);
+        glUniform2f(viewportLoc, (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT);
+        glUniform2f(originLoc, GRID_OFFSET_X, GRID_OFFSET_Y);
+        glUniform2f(sizeLoc, columns * BLOCK_SIZE, rows * BLOCK_SIZE);
         
-        if (checkCollision(currentPiece, 0, 0)) {
-            gameOver = true;
-        }
+        glBindVertexArray(VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        stats->drawCalls++;
     }
+};
+
+// Draw calls GLCanvas issues for a frame of a new game: a batch of panel
+// rectangles, the panel's seven text meshes, each button's rectangle and
+// label, the board's quad and the falling piece's batch. Layer copies are
+// blits, not draws, so an idle frame only draws the piece.
+const FrameDrawCalls GL_FRAME_DRAW_CALLS = {14, 1};
+
+// The OpenGL canvas TetrisScene draws through: rectangles are batched by
+// QuadRenderer, text comes from TextCache meshes, layers are LayerCache
+// framebuffers and the board is BoardRenderer's single quad.
+struct GLCanvas {
+    DrawStats drawStats;
+    QuadRenderer quads;
+    TextCache textCache;
+    LayerCache layers;
+    BoardRenderer boardRenderer;
+    // The core's cells unpacked to one byte each for the board texture.
+    vector<uint8_t> boardCells;
     
-    bool checkCollision(const Tetromino& piece, int dx, int dy) {
-        for (int y = 0; y < 4; y++) {
-            for (int x = 0; x < 4; x++) {
-                if (piece.shape[y][x]) {
-                    int newX = piece.x + x + dx;
-                    int newY = piece.y + y + dy;
-                    
-                    if (newX < 0 || newX >= GRID_WIDTH || newY >= GRID_HEIGHT) {
-                        return true;
-                    }
-                    
-                    if (newY >= 0 && grid[newY][newX]) {
-                        return true;
-                    }
-                }
-            }
-        }
-        return false;
+    void init() {
+        quads.init(&drawStats);
+        textCache.init(&quads);
+        layers.init();
+        boardRenderer.init(&drawStats);
     }
     
-    void placePiece() {
-        for (int y = 0; y < 4; y++) {
-            for (int x = 0; x < 4; x++) {
-                if (currentPiece.shape[y][x]) {
-                    int gridX = currentPiece.x + x;
-                    int gridY = currentPiece.y + y;
-                    
-                    if (gridY >= 0) {
-                        grid[gridY][gridX] = 1;
-                        memcpy(gridColors[gridY][gridX], currentPiece.color, sizeof(currentPiece.color));
-                    }
-                }
-            }
-        }
-        
-        int clearedLines = clearLines();
-        updateScore(clearedLines);
-        spawnNewPiece();
+    void rect(float x, float y, float w, float h, const float color[3], float brightness = 1.0f) {
+        quads.rect(x, y, w, h, color, brightness);
     }
     
-    int clearLines() {
-        int clearedCount = 0;
-        
-        for (int y = GRID_HEIGHT - 1; y >= 0; y--) {
-            bool fullLine = true;
-            for (int x = 0; x < GRID_WIDTH; x++) {
-                if (!grid[y][x]) {
-                    fullLine = false;
-                    break;
-                }
-            }
-            
-            if (fullLine) {
-                clearedCount++;
-                
-                for (int moveY = y; moveY > 0; moveY--) {
-                    for (int x = 0; x < GRID_WIDTH; x++) {
-                        grid[moveY][x] = grid[moveY - 1][x];
-                        memcpy(gridColors[moveY][x], gridColors[moveY - 1][x], sizeof(gridColors[moveY][x]));
-                    }
-                }
-                
-                for (int x = 0; x < GRID_WIDTH; x++) {
-                    grid[0][x] = 0;
-                    memset(gridColors[0][x], 0, sizeof(gridColors[0][x]));
-                }
-                
-                y++;
-            }
-        }
-        
-        return clearedCount;
+    void text(const string& text, float x, float y, const float color[3], float pixelSize) {
+        textCache.draw(text, x, y, color, pixelSize);
     }
     
-    void updateScore(int clearedLines) {
-        if (clearedLines > 0) {
-            linesCleared += clearedLines;
-            score += SCORE_VALUES[clearedLines - 1] * level;
-            
-            int newLevel = (linesCleared / 10) + 1;
-            if (newLevel > level) {
-                level = newLevel;
-                fallSpeed = baseFallSpeed / (1.0 + (level - 1) * 0.1);
-            }
-        }
+    void flush() {
+        quads.flush();
     }
     
-    void rotatePiece() {
-        Tetromino rotated = currentPiece;
-        
-        for (int y = 0; y < 4; y++) {
-            for (int x = 0; x < 4; x++) {
-                rotated.shape[x][3-y] = currentPiece.shape[y][x];
-            }
-        }
-        
-        if (!checkCollision(rotated, 0, 0)) {
-            currentPiece = rotated;
-            return;
-        }
-        
-        int kicks[][2] = {{-1, 0}, {1, 0}, {0, -1}, {-1, -1}, {1, -1}};
-        for (int i = 0; i < 5; i++) {
-            if (!checkCollision(rotated, kicks[i][0], kicks[i][1])) {
-                currentPiece = rotated;
-                currentPiece.x += kicks[i][0];
-                currentPiece.y += kicks[i][1];
-                return;
-            }
-        }
+    // The HUD goes straight into the quad batch, uncached.
+    void overlayRect(float x, float y, float w, float h, const float color[3]) {
+        quads.rect(x, y, w, h, color);
     }
     
-    void update(double currentTime) {
-        if (gameOver || gamePaused || showHelp) return;
-        
-        if (currentTime - lastFallTime >= fallSpeed) {
-            if (!checkCollision(currentPiece, 0, 1)) {
-                currentPiece.y++;
-            } else {
-                placePiece();
-            }
-            lastFallTime = currentTime;
-        }
+    void overlayText(const string& text, float x, float y, const float color[3], float pixelSize) {
+        quads.text(text, x, y, color, pixelSize);
     }
     
-    bool isKeyPressed(int key) {
-        return keyStates[key] && !prevKeyStates[key];
+    void flushOverlay() {
+        quads.flush();
     }
     
-    void updateInput(GLFWwindow* window) {
-        memcpy(prevKeyStates, keyStates, sizeof(keyStates));
-        prevMousePressed = mousePressed;
-        
-        for (int i = 0; i < GLFW_KEY_LAST; i++) {
-            keyStates[i] = glfwGetKey(window, i) == GLFW_PRESS;
-        }
-        
-        mousePressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
-        glfwGetCursorPos(window, &mouseX, &mouseY);
-        
-        restartButtonHovered = (mouseX >= restartButtonX && mouseX <= restartButtonX + restartButtonW &&
-                               mouseY >= restartButtonY && mouseY <= restartButtonY + restartButtonH);
-
-        helpButtonHovered = (mouseX >= helpButtonX && mouseX <= helpButtonX + helpButtonW &&
-                            mouseY >= helpButtonY && mouseY <= helpButtonY + helpButtonH);
-
-        closeHelpButtonHovered = showHelp && (mouseX >= closeHelpButtonX && mouseX <= closeHelpButtonX + closeHelpButtonW &&
-                        mouseY >= closeHelpButtonY && mouseY <= closeHelpButtonY + closeHelpButtonH);
+    template <typename Core>
+    void drawBoard(const Core& core) {
+        boardCells.resize(Core::WIDTH * Core::HEIGHT);
+        core.copyCells(boardCells.data());
+        boardRenderer.draw(boardCells.data() + Core::HIDDEN_ROWS * Core::WIDTH, Core::WIDTH, Core::VISIBLE_HEIGHT,
+                           core.getBoardVersion());
     }
     
-    bool isMouseClicked() {
-        return mousePressed && !prevMousePressed;
+    bool beginLayer(Layer layer) {
+        return layers.begin(layer);
     }
     
-    void handleInput(GLFWwindow* window) {
-        updateInput(window);
-        
-        if (isMouseClicked()) {
-            if (restartButtonHovered) {
-                restartGame();
-                return;
-            }
-            if (helpButtonHovered) {
-                showHelp = !showHelp;
-                return;
-            }
-            if (closeHelpButtonHovered) {
-                showHelp = false;
-                return;
-            }
-        }
-        
-        if (showHelp) return;
-        
-        if (isKeyPressed(GLFW_KEY_P)) {
-            gamePaused = !gamePaused;
-        }
-        
-        if (isKeyPressed(GLFW_KEY_R)) {
-            restartGame();
-        }
-        
-        if (gameOver || gamePaused) return;
-        
-        if (isKeyPressed(GLFW_KEY_LEFT) || isKeyPressed(GLFW_KEY_A)) {
-            if (!checkCollision(currentPiece, -1, 0)) {
-                currentPiece.x--;
-            }
-        }
-        
-        if (isKeyPressed(GLFW_KEY_RIGHT) || isKeyPressed(GLFW_KEY_D)) {
-            if (!checkCollision(currentPiece, 1, 0)) {
-                currentPiece.x++;
-            }
-        }
-        
-        if (isKeyPressed(GLFW_KEY_DOWN) || isKeyPressed(GLFW_KEY_S)) {
-            if (!checkCollision(currentPiece, 0, 1)) {
-                currentPiece.y++;
-            }
-        }
-        
-        if (isKeyPressed(GLFW_KEY_SPACE)) {
-            while (!checkCollision(currentPiece, 0, 1)) {
-                currentPiece.y++;
-            }
-        }
-        
-        if (isKeyPressed(GLFW_KEY_UP) || isKeyPressed(GLFW_KEY_W)) {
-            rotatePiece();
-        }
+    void endLayer(Layer layer) {
+        layers.end(layer);
     }
     
-    void restartGame() {
-        memset(grid, 0, sizeof(grid));
-        memset(gridColors, 0, sizeof(gridColors));
-        gameOver = false;
-        gamePaused = false;
-        showHelp = false;
-        score = 0;
-        level = 1;
-        linesCleared = 0;
-        fallSpeed = baseFallSpeed;
-        nextPiece.setType(shapeDist(rng));
-        spawnNewPiece();
+    void composite(Layer layer, float x, float y, float w, float h) {
+        layers.composite(layer, x, y, w, h);
     }
     
-    void drawBlock(float x, float y, const float color[3], float brightness = 1.0f) {
-        glUseProgram(shaderProgram);
-        
-        GLint translationLoc = glGetUniformLocation(shaderProgram, "uTranslation");
-        GLint scaleLoc = glGetUniformLocation(shaderProgram, "uScale");
-        GLint colorLoc = glGetUniformLocation(shaderProgram, "uColor");
-        GLint brightnessLoc = glGetUniformLocation(shaderProgram, "uBrightness");
-        
-        glUniform2f(translationLoc, x * BLOCK_SIZE + GRID_OFFSET_X, y * BLOCK_SIZE + GRID_OFFSET_Y);
-        glUniform2f(scaleLoc, BLOCK_SIZE - 1, BLOCK_SIZE - 1);
-        glUniform3f(colorLoc, color[0], color[1], color[2]);
-        glUniform1f(brightnessLoc, brightness);
-        
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+    void invalidate(Layer layer) {
+        layers.invalidate(layer);
     }
     
-    void render() {
-        glClear(GL_COLOR_BUFFER_BIT);
-        glClearColor(0.05f, 0.05f, 0.1f, 1.0f);
-        
-        drawBorder();
-        
-        float gridColor[3] = {0.2f, 0.2f, 0.3f};
-        for (int y = 0; y < GRID_HEIGHT; y++) {
-            for (int x = 0; x < GRID_WIDTH; x++) {
-                drawBlock(x, y, gridColor, 0.3f);
-            }
-        }
-        
-        for (int y = 0; y < GRID_HEIGHT; y++) {
-            for (int x = 0; x < GRID_WIDTH; x++) {
-                if (grid[y][x]) {
-                    drawBlock(x, y, gridColors[y][x]);
-                }
-            }
-        }
-        
-        if (!gameOver && !gamePaused && !showHelp) {
-            for (int y = 0; y < 4; y++) {
-                for (int x = 0; x < 4; x++) {
-                    if (currentPiece.shape[y][x]) {
-                        drawBlock(currentPiece.x + x, currentPiece.y + y, currentPiece.color);
-                    }
-                }
-            }
-        }
-        
-        float panelColor[3] = {0.15f, 0.15f, 0.2f};
-        glUseProgram(shaderProgram);
-        GLint translationLoc = glGetUniformLocation(shaderProgram, "uTranslation");
-        GLint scaleLoc = glGetUniformLocation(shaderProgram, "uScale");
-        GLint colorLoc = glGetUniformLocation(shaderProgram, "uColor");
-        GLint brightnessLoc = glGetUniformLocation(shaderProgram, "uBrightness");
-        
-        float panelX = WINDOW_WIDTH - 220;
-        float panelY = GRID_OFFSET_Y;
-        float panelW = 200;
-        float panelH = GRID_HEIGHT * BLOCK_SIZE;
-        
-        glUniform2f(translationLoc, panelX, panelY);
-        glUniform2f(scaleLoc, panelW, panelH);
-        glUniform3f(colorLoc, panelColor[0], panelColor[1], panelColor[2]);
-        glUniform1f(brightnessLoc, 1.0f);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        float textColor[3] = {1.0f, 1.0f, 1.0f};
-        float uiX = panelX + 10;
-        float uiY = panelY + 20;
-        
-        drawText("SCORE:", uiX, uiY, textColor, 2.5f);
-        drawText(to_string(score), uiX, uiY + 25, textColor, 2.5f);
-
-        drawText("LEVEL:", uiX, uiY + 65, textColor, 2.5f);
-        drawText(to_string(level), uiX, uiY + 90, textColor, 2.5f);
-
-        drawText("LINES:", uiX, uiY + 130, textColor, 2.5f);
-        drawText(to_string(linesCleared), uiX, uiY + 155, textColor, 2.5f);
+    int getLayerRenderCount(Layer layer) const {
+        return layers.getRenderCount(layer);
+    }
+    
+    void beginFrame() {
+        drawStats.beginFrame();
+    }
+    
+    void endFrame() {
+        textCache.endFrame();
+    }
+    
+    int getFrameDrawCalls() const {
+        return drawStats.drawCalls;
+    }
+};
 
-        drawText("NEXT:", uiX, uiY + 195, textColor, 2.5f);
-        float previewX = (panelX + 20 - GRID_OFFSET_X) / BLOCK_SIZE;
-        float previewY = (uiY + 220 - GRID_OFFSET_Y) / BLOCK_SIZE;
-        for (int y = 0; y < 4; y++) {
-            for (int x = 0; x < 4; x++) {
-                if (nextPiece.shape[y][x]) {
-                    drawBlock(previewX + x, previewY + y, nextPiece.color, 0.8f);
-                }
-            }
-        }
-        
-        restartButtonX = panelX + 40;
-        restartButtonY = 370;
-        drawButton(restartButtonX, restartButtonY, restartButtonW, restartButtonH, 
-                  "RESTART", restartButtonHovered);
+static_assert(KEY_SPACE == GLFW_KEY_SPACE && KEY_A == GLFW_KEY_A && KEY_D == GLFW_KEY_D && KEY_I == GLFW_KEY_I &&
+                  KEY_P == GLFW_KEY_P && KEY_R == GLFW_KEY_R && KEY_S == GLFW_KEY_S && KEY_W == GLFW_KEY_W &&
+                  KEY_RIGHT == GLFW_KEY_RIGHT && KEY_LEFT == GLFW_KEY_LEFT && KEY_DOWN == GLFW_KEY_DOWN &&
+                  KEY_UP == GLFW_KEY_UP,
+              "GameKey codes are GLFW's");
 
-        helpButtonX = panelX + 40;
-        helpButtonY = 470;
-        drawButton(helpButtonX, helpButtonY, helpButtonW, helpButtonH, 
-                  "HELP", helpButtonHovered);
-        
-        if (gamePaused) {
-            float pauseColor[3] = {1.0f, 1.0f, 0.0f};
-            drawText("PAUSED", uiX, uiY + 480, pauseColor, 3.0f);
-        }
-        
-        if (gameOver) {
-            float gameOverColor[3] = {1.0f, 0.0f, 0.0f};
-            drawText("GAME", uiX, uiY + 480, gameOverColor, 3.0f);
-            drawText("OVER", uiX, uiY + 510, gameOverColor, 3.0f);
-        }
-        
-        drawHelpOverlay();
-    }
+// The GLFW window as TetrisGame sees it.
+struct GlfwWindow {
+    GLFWwindow* handle;
     
-    bool isGameOver() const {
-        return gameOver;
+    double time() const {
+        return glfwGetTime();
     }
     
-    bool isPaused() const {
-        return gamePaused;
+    void getCursorPos(double& x, double& y) const {
+        glfwGetCursorPos(handle, &x, &y);
     }
     
-    int getScore() const {
-        return score;
+    bool shouldClose() const {
+        return glfwWindowShouldClose(handle);
     }
     
-    int getLevel() const {
-        return level;
+    void swapBuffers() {
+        TRACE_ZONE("glfwSwapBuffers");
+        glfwSwapBuffers(handle);
     }
     
-    int getLines() const {
-        return linesCleared;
+    void pollEvents() {
+        TRACE_ZONE("glfwPollEvents");
+        glfwPollEvents();
     }
 };
 
-int main() {
+typedef TetrisGame<GlfwWindow, GLCanvas> WindowGame;
+
+// GLFW callbacks, installed by main with the game as the window's user
+// pointer. Window-only keys are handled here and the rest passed on.
+void keyCallback(GLFWwindow* window, int key, int, int action, int) {
+    // Held keys repeat through AutoRepeat, not the OS key repeat.
+    if (action == GLFW_REPEAT) return;
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+        glfwSetWindowShouldClose(window, true);
+    }
+    WindowGame* game = (WindowGame*)glfwGetWindowUserPointer(window);
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+        game->toggleHud();
+        return;
+    }
+    game->keyEvent(key, action == GLFW_PRESS, glfwGetTime());
+}
+
+void focusCallback(GLFWwindow* window, int focused) {
+    if (!focused) ((WindowGame*)glfwGetWindowUserPointer(window))->focusLost(glfwGetTime());
+}
+
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int) {
+    WindowGame* game = (WindowGame*)glfwGetWindowUserPointer(window);
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+        game->mouseClick();
+    }
+}
+
+
+int main(int argc, char** argv) {
+    const char* tracePath = NULL;
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    const char* latencyPath = NULL;
+    InputTiming timing;
+    int swapInterval = 1;
+    int idleFrames = 0;
+    bool singleThread = false;
+    PieceRandomizer randomizer = RANDOMIZER_UNIFORM;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--das") == 0 && i + 1 < argc) {
+            timing.dasTicks = InputTiming::ticksFromMs(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--arr") == 0 && i + 1 < argc) {
+            timing.arrTicks = InputTiming::ticksFromMs(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--sdr") == 0 && i + 1 < argc) {
+            timing.softDropTicks = InputTiming::ticksFromMs(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--swap-interval") == 0 && i + 1 < argc) {
+            swapInterval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--latency-report") == 0 && i + 1 < argc) {
+            latencyPath = argv[++i];
+        } else if (strcmp(argv[i], "--check-idle-frames") == 0 && i + 1 < argc) {
+            idleFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--single-thread") == 0) {
+            singleThread = true;
+        } else if (strcmp(argv[i], "--randomizer") == 0 && i + 1 < argc && parseRandomizer(argv[i + 1], randomizer)) {
+            i++;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--trace trace.json] [--record game.replay | --replay game.replay]"
+                 << " [--das ms] [--arr ms] [--sdr ms] [--swap-interval n] [--randomizer uniform|bag] [--single-thread]"
+                 << " [--latency-report latency.json] [--check-idle-frames n]" << endl;
+            return -1;
+        }
+    }
+    
+    unsigned int seed = random_device{}();
+    ReplayFile replayFile;
+    InputRecording replayRecording;
+    if (replayPath) {
+        if (!replayFile.open(replayPath) || !replayFile.readRecording(replayRecording)) {
+            cerr << "Failed to load replay " << replayPath << endl;
+            return -1;
+        }
+        seed = replayRecording.seed;
+        randomizer = replayRecording.randomizer;
+    }
+    InputRecording recording(seed, randomizer);
+    ReplayPlayer replayPlayer(replayRecording);
+    
+    if (tracePath) {
+        Tracer::instance().setEnabled(true);
+        Tracer::instance().setThreadName("main");
+    }
+    
     if (!glfwInit()) {
         cerr << "Failed to initialize GLFW" << endl;
         return -1;
@@ -1172,7 +729,7 @@ int main() {
     
     glfwMakeContextCurrent(window);
     glfwFocusWindow(window);
-    glfwSwapInterval(1);
+    glfwSwapInterval(swapInterval);
     
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         cerr << "Failed to initialize GLAD" << endl;
@@ -1184,28 +741,67 @@ int main() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     
-    TetrisGame game;
+    // Draws idle frames through the OpenGL layer caches and checks none of
+    // them re-rendered a layer and that frames issue GL_FRAME_DRAW_CALLS,
+    // then exits.
+    if (idleFrames > 0) {
+        int failures;
+        {
+            GLCanvas canvas;
+            canvas.init();
+            failures = checkIdleFrames<TetrisCore>(canvas, idleFrames, cout);
+            failures += checkFrameDrawCalls<TetrisCore>(canvas, GL_FRAME_DRAW_CALLS, cout);
+        }
+        glfwTerminate();
+        cout << (failures ? "frames re-rendered layers or issued unexpected draw calls"
+                          : "no idle frame re-rendered a layer") << endl;
+        return failures ? 2 : 0;
+    }
+    
+    GlfwWindow gameWindow = {window};
+    WindowGame game(gameWindow, seed, randomizer, timing, recordPath ? &recording : NULL,
+                    replayPath ? &replayPlayer : NULL, replayPath ? &replayFile : NULL);
+    glfwSetWindowUserPointer(window, &game);
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetWindowFocusCallback(window, focusCallback);
     
     cout << "Tetris Game Started!" << endl;
     cout << "Use WASD or Arrow Keys to play" << endl;
     cout << "Click RESTART button or press R to restart" << endl;
     cout << "Click HELP button for game instructions" << endl;
     
-    while (!glfwWindowShouldClose(window)) {
-        double currentTime = glfwGetTime();
-        
-        game.handleInput(window);
-        game.update(currentTime);
-        game.render();
-        
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-        
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-            glfwSetWindowShouldClose(window, true);
+    FrameProfiler profiler;
+    game.run(profiler, singleThread);
+    glfwTerminate();
+    
+    if (recordPath) {
+        game.finishRecording();
+        if (recording.save(recordPath)) {
+            cout << "Recorded " << recording.events.size() << " inputs to " << recordPath << endl;
+        } else {
+            cerr << "Failed to write recording to " << recordPath << endl;
         }
     }
     
-    glfwTerminate();
+    if (latencyPath) {
+        ofstream latencyFile(latencyPath);
+        latencyFile << "{";
+        writeLatencyReport(latencyFile, game.getLatency());
+        latencyFile << "}\n";
+        if (latencyFile) {
+            cout << "Latency report written to " << latencyPath << endl;
+        } else {
+            cerr << "Failed to write latency report to " << latencyPath << endl;
+        }
+    }
+    
+    if (tracePath) {
+        if (Tracer::instance().writeChromeTrace(tracePath)) {
+            cout << "Trace written to " << tracePath << endl;
+        } else {
+            cerr << "Failed to write trace to " << tracePath << endl;
+        }
+    }
     return 0;
 }
@@ -0,0 +1,124 @@
+#ifndef TETRIS_FONT_H
+#define TETRIS_FONT_H
+
+// 5x7 bitmap font. The glyph bitmaps are baked at compile time into a list
+// of horizontal runs per character, so a string becomes a handful of quads
+// with no per-pixel tests or map lookups.
+
+#include "tetrisDraw.h"
+#include <cstdint>
+#include <string>
+
+const int GLYPH_WIDTH = 5;
+const int GLYPH_HEIGHT = 7;
+const int GLYPH_ADVANCE = 6;
+
+struct GlyphBitmap {
+    char c;
+    uint8_t rows[GLYPH_HEIGHT];
+};
+
+// Bit 4 of each row is the leftmost column.
+constexpr GlyphBitmap FONT_GLYPHS[] = {
+    {'0', {0b11111, 0b10001, 0b10001, 0b10001, 0b10001, 0b10001, 0b11111}},
+    {'1', {0b00100, 0b01100, 0b00100, 0b00100, 0b00100, 0b00100, 0b01110}},
+    {'2', {0b11111, 0b00001, 0b00001, 0b11111, 0b10000, 0b10000, 0b11111}},
+    {'3', {0b11111, 0b00001, 0b00001, 0b11111, 0b00001, 0b00001, 0b11111}},
+    {'4', {0b10001, 0b10001, 0b10001, 0b11111, 0b00001, 0b00001, 0b00001}},
+    {'5', {0b11111, 0b10000, 0b10000, 0b11111, 0b00001, 0b00001, 0b11111}},
+    {'6', {0b11111, 0b10000, 0b10000, 0b11111, 0b10001, 0b10001, 0b11111}},
+    {'7', {0b11111, 0b00001, 0b00001, 0b00010, 0b00100, 0b01000, 0b10000}},
+    {'8', {0b11111, 0b10001, 0b10001, 0b11111, 0b10001, 0b10001, 0b11111}},
+    {'9', {0b11111, 0b10001, 0b10001, 0b11111, 0b00001, 0b00001, 0b11111}},
+    {'S', {0b11111, 0b10000, 0b10000, 0b11111, 0b00001, 0b00001, 0b11111}},
+    {'C', {0b11111, 0b10000, 0b10000, 0b10000, 0b10000, 0b10000, 0b11111}},
+    {'O', {0b11111, 0b10001, 0b10001, 0b10001, 0b10001, 0b10001, 0b11111}},
+    {'R', {0b11110, 0b10001, 0b10001, 0b11110, 0b10100, 0b10010, 0b10001}},
+    {'E', {0b11111, 0b10000, 0b10000, 0b11110, 0b10000, 0b10000, 0b11111}},
+    {'L', {0b10000, 0b10000, 0b10000, 0b10000, 0b10000, 0b10000, 0b11111}},
+    {'V', {0b10001, 0b10001, 0b10001, 0b10001, 0b10001, 0b01010, 0b00100}},
+    {'N', {0b10001, 0b11001, 0b10101, 0b10011, 0b10001, 0b10001, 0b10001}},
+    {'X', {0b10001, 0b01010, 0b00100, 0b00100, 0b00100, 0b01010, 0b10001}},
+    {'T', {0b11111, 0b00100, 0b00100, 0b00100, 0b00100, 0b00100, 0b00100}},
+    {':', {0b00000, 0b00100, 0b00000, 0b00000, 0b00000, 0b00100, 0b00000}},
+    {' ', {0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b00000}},
+    {'P', {0b11110, 0b10001, 0b10001, 0b11110, 0b10000, 0b10000, 0b10000}},
+    {'A', {0b01110, 0b10001, 0b10001, 0b11111, 0b10001, 0b10001, 0b10001}},
+    {'U', {0b10001, 0b10001, 0b10001, 0b10001, 0b10001, 0b10001, 0b11111}},
+    {'G', {0b11111, 0b10000, 0b10000, 0b10111, 0b10001, 0b10001, 0b11111}},
+    {'M', {0b10001, 0b11011, 0b10101, 0b10001, 0b10001, 0b10001, 0b10001}},
+    {'I', {0b11111, 0b00100, 0b00100, 0b00100, 0b00100, 0b00100, 0b11111}},
+    {'H', {0b10001, 0b10001, 0b10001, 0b11111, 0b10001, 0b10001, 0b10001}},
+    {'W', {0b10001, 0b10001, 0b10001, 0b10101, 0b10101, 0b11011, 0b10001}},
+    {'D', {0b11110, 0b10001, 0b10001, 0b10001, 0b10001, 0b10001, 0b11110}},
+    {'F', {0b11111, 0b10000, 0b10000, 0b11110, 0b10000, 0b10000, 0b10000}},
+    {'Y', {0b10001, 0b10001, 0b01010, 0b00100, 0b00100, 0b00100, 0b00100}},
+    {'K', {0b10001, 0b10010, 0b10100, 0b11000, 0b10100, 0b10010, 0b10001}},
+    {'-', {0b00000, 0b00000, 0b00000, 0b11111, 0b00000, 0b00000, 0b00000}},
+    {'/', {0b00001, 0b00010, 0b00100, 0b01000, 0b10000, 0b00000, 0b00000}},
+    {'.', {0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b00100}},
+};
+
+struct GlyphRun {
+    uint8_t row = 0, col = 0, length = 0;
+};
+
+struct GlyphQuads {
+    bool defined = false;
+    uint8_t count = 0;
+    GlyphRun runs[GLYPH_HEIGHT * 3] = {};
+};
+
+struct GlyphAtlas {
+    GlyphQuads glyphs[128];
+
+    constexpr GlyphAtlas() : glyphs() {
+        for (const GlyphBitmap& bitmap : FONT_GLYPHS) {
+            GlyphQuads& quads = glyphs[(unsigned char)bitmap.c];
+            quads.defined = true;
+            for (int row = 0; row < GLYPH_HEIGHT; row++) {
+                int col = 0;
+                while (col < GLYPH_WIDTH) {
+                    if (!(bitmap.rows[row] & (0x10 >> col))) {
+                        col++;
+                        continue;
+                    }
+                    int start = col;
+                    while (col < GLYPH_WIDTH && (bitmap.rows[row] & (0x10 >> col))) col++;
+                    GlyphRun& run = quads.runs[quads.count++];
+                    run.row = (uint8_t)row;
+                    run.col = (uint8_t)start;
+                    run.length = (uint8_t)(col - start);
+                }
+            }
+        }
+    }
+
+    const GlyphQuads* find(char c) const {
+        unsigned char index = (unsigned char)c;
+        if (index >= 128 || !glyphs[index].defined) return nullptr;
+        return &glyphs[index];
+    }
+};
+
+constexpr GlyphAtlas GLYPH_ATLAS;
+
+// Appends the quads for text with its top-left corner at (x, y). Characters
+// without a glyph are skipped but still advance the pen.
+inline void buildTextQuads(QuadBatch& batch, const std::string& text, float x, float y,
+                           const float color[3], float pixelSize) {
+    float currentX = x;
+    for (char c : text) {
+        const GlyphQuads* glyph = GLYPH_ATLAS.find(c);
+        if (glyph) {
+            for (int i = 0; i < glyph->count; i++) {
+                const GlyphRun& run = glyph->runs[i];
+                batch.rect(currentX + run.col * pixelSize, y + run.row * pixelSize,
+                           run.length * pixelSize, pixelSize, color);
+            }
+        }
+        currentX += GLYPH_ADVANCE * pixelSize;
+    }
+}
+
+#endif
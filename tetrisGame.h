@@ -0,0 +1,682 @@
+#ifndef TETRIS_GAME_H
+#define TETRIS_GAME_H
+
+// The interactive game: the simulation, on its own thread or the main one,
+// and the main loop that draws snapshots of it. TetrisGame knows nothing of
+// OpenGL or GLFW; it runs against a Window and draws through a Canvas, so
+// tetrisFinal.cpp runs it in a GLFW window and tetrisInject.cpp runs the
+// same loop against a mock window with no display.
+//
+// A window provides:
+//   time()                   seconds on a monotonic clock, from any thread
+//   getCursorPos(x, y)       the mouse, in window pixels
+//   shouldClose()
+//   swapBuffers()            presents the frame drawn since the last swap
+//   pollEvents()             reports input through the game's keyEvent()
+//                            and mouseClick()
+// A canvas is a TetrisScene canvas that also provides init(), called once
+// before the first frame, overlayRect(), overlayText() and flushOverlay()
+// for the HUD, drawn over the frame without layer or text caching, and
+// getFrameDrawCalls().
+
+#include "tetrisAI.h"
+#include "tetrisClock.h"
+#include "tetrisCore.h"
+#include "tetrisInput.h"
+#include "tetrisLatency.h"
+#include "tetrisProfile.h"
+#include "tetrisReplay.h"
+#include "tetrisScene.h"
+#include "tetrisSnapshot.h"
+#include "tetrisTrace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Key codes the game acts on. They are GLFW's numbers, so a GLFW window
+// passes its keys straight through.
+enum GameKey {
+    KEY_SPACE = 32,
+    KEY_A = 65,
+    KEY_D = 68,
+    KEY_I = 73,
+    KEY_P = 80,
+    KEY_R = 82,
+    KEY_S = 83,
+    KEY_W = 87,
+    KEY_RIGHT = 262,
+    KEY_LEFT = 263,
+    KEY_DOWN = 264,
+    KEY_UP = 265,
+    // Not a key: the window lost focus and will not report the releases
+    // of keys still held.
+    KEY_FOCUS_LOST = -1
+};
+
+// The player input a key is bound to, or INPUT_COUNT if none.
+inline GameInput keyInput(int key) {
+    switch (key) {
+        case KEY_LEFT: case KEY_A: return INPUT_LEFT;
+        case KEY_RIGHT: case KEY_D: return INPUT_RIGHT;
+        case KEY_DOWN: case KEY_S: return INPUT_SOFT_DROP;
+        case KEY_SPACE: return INPUT_HARD_DROP;
+        case KEY_UP: case KEY_W: return INPUT_ROTATE;
+        default: return INPUT_COUNT;
+    }
+}
+
+// What the render thread draws a frame from: a copy of the game and the
+// simulation-side state the HUD shows. Published by the simulation after
+// every batch of ticks, so it never changes while a frame is drawn from it.
+struct RenderSnapshot {
+    TetrisCore core;
+    // Wall-clock time it was published, and how far past the last tick
+    // that was.
+    double time;
+    double alpha;
+    uint32_t tick;
+    bool aiEnabled;
+    AIStats aiStats;
+    // The number of the last key press handled before it was taken.
+    uint32_t inputsHandled;
+    // Collision tests the simulation had made, wrapping at 2^32.
+    uint32_t collisionChecks;
+    
+    RenderSnapshot()
+        : core(0), time(0.0), alpha(0.0), tick(0), aiEnabled(false), inputsHandled(0), collisionChecks(0) {}
+};
+
+// How long a frame waits for the simulation thread to handle the keys
+// polled at the end of the last one, a quarter of a tick.
+const double KEY_WAIT_SECONDS = 0.25 / TICKS_PER_SECOND;
+
+template <typename Window, typename Canvas>
+class TetrisGame {
+private:
+    Window& window;
+    
+    // Simulation state. With a simulation thread running only it touches
+    // these; the window sees the game through snapshots.
+    TetrisCore core;
+    
+    // Ticks the core has run; inputs are stamped with it when recorded.
+    uint32_t tick;
+    TickClock clock;
+    InputRecording* recording;
+    ReplayPlayer* replay;
+    const ReplayFile* replayFile;
+    bool replayReported;
+    
+    TetrisAI ai;
+    bool aiEnabled;
+    bool aiPlanned;
+    std::vector<PlacementMove> aiMoves;
+    size_t aiMoveIndex;
+    Tetromino aiExpected;
+    int aiPiecesPlaced;
+    
+    AutoRepeat autoRepeat;
+    uint32_t restartsHandled;
+    // Key events taken off the queue.
+    uint32_t keysHandled;
+    // Collision tests made by update(), wrapping at 2^32. The core does not
+    // count them; the thread running update() does, in its TraceCounters.
+    uint32_t collisionChecks;
+    
+    // Between the window and the simulation.
+    KeyEventQueue keyEvents;
+    TripleBuffer<RenderSnapshot> snapshots;
+    // Set while the help overlay has the game frozen.
+    std::atomic<bool> helpFrozen;
+    // Restarts asked for from the window, by the RESTART button.
+    std::atomic<uint32_t> restartRequests;
+    // Handled presses, on their way to the frame that first shows them.
+    InputLatencyTracker latency;
+    
+    std::thread simulation;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool wakeRequested;
+    bool stopRequested;
+    // keysHandled as of the last snapshot published, under wakeMutex, and
+    // signalled on published.
+    uint32_t keysPublished;
+    std::condition_variable published;
+    
+    // Window state, touched only by the main thread.
+    RenderSnapshot displayed;
+    // Key events pushed onto the queue.
+    uint32_t keysQueued;
+    // When the frame being drawn started.
+    double frameTime;
+    bool showHud;
+    Canvas canvas;
+    TetrisScene<Canvas> scene;
+    SceneUi ui;
+    bool mouseClicked = false;
+    double mouseX = 0, mouseY = 0;
+    
+public:
+    // Records every input into recording, or plays replay's inputs back
+    // instead of the player's, when given. replayFile is the file replay
+    // was read from, which the arrow keys seek through. timing sets how
+    // held keys repeat.
+    TetrisGame(Window& window, unsigned int seed, PieceRandomizer randomizer, const InputTiming& timing,
+               InputRecording* recording = NULL, ReplayPlayer* replay = NULL, const ReplayFile* replayFile = NULL)
+        : window(window), core(seed, randomizer), recording(recording), replay(replay), replayFile(replayFile),
+          autoRepeat(timing), scene(canvas) {
+        showHud = false;
+        tick = 0;
+        double now = window.time();
+        frameTime = now;
+        clock = TickClock(now);
+        replayReported = false;
+        aiEnabled = false;
+        aiPlanned = false;
+        aiMoveIndex = 0;
+        aiPiecesPlaced = 0;
+        restartsHandled = 0;
+        keysHandled = 0;
+        collisionChecks = 0;
+        keysPublished = 0;
+        keysQueued = 0;
+        helpFrozen = false;
+        restartRequests = 0;
+        wakeRequested = false;
+        stopRequested = false;
+        
+        canvas.init();
+        publishSnapshot(now);
+        snapshots.acquire();
+        displayed = snapshots.front();
+    }
+    
+    ~TetrisGame() {
+        stopSimulation();
+    }
+    
+    // The main loop, until the window closes. Each frame handles the mouse,
+    // draws the newest snapshot and swaps; with singleThread it also runs
+    // the simulation, between handling the mouse and drawing. Swap stalls
+    // and slow frames hold up only this thread otherwise; the game keeps
+    // ticking on its own, and a frame only waits for it to catch up with
+    // the keys polled since the last one.
+    void run(FrameProfiler& profiler, bool singleThread) {
+        uint32_t lastCollisionChecks = getCollisionChecks();
+        if (!singleThread) startSimulation();
+        
+        while (!window.shouldClose()) {
+            TRACE_ZONE("frame");
+            double currentTime = window.time();
+            profiler.beginFrame();
+            
+            handleInput();
+            profiler.endPhase(PHASE_INPUT);
+            if (singleThread) {
+                update(currentTime);
+                publishSnapshot(currentTime);
+            } else {
+                awaitKeys();
+            }
+            profiler.endPhase(PHASE_SIMULATION);
+            render(currentTime);
+            renderHud(profiler);
+            profiler.endPhase(PHASE_RENDER);
+            
+            latency.swapStarting(displayed.inputsHandled, window.time());
+            window.swapBuffers();
+            latency.swapFinished(window.time());
+            profiler.endPhase(PHASE_SWAP);
+            window.pollEvents();
+            profiler.endPhase(PHASE_INPUT);
+            
+            uint32_t collisionChecks = getCollisionChecks();
+            profiler.setFrameCounters(getFrameDrawCalls(), (long long)(collisionChecks - lastCollisionChecks));
+            lastCollisionChecks = collisionChecks;
+        }
+        
+        stopSimulation();
+    }
+    
+    // Moves the simulation onto its own thread, which runs ticks as they
+    // come due and handles keys as they arrive, whatever the window is
+    // doing. Without it the main loop calls update() once a frame.
+    void startSimulation() {
+        simulation = std::thread([this]() { simulationLoop(); });
+    }
+    
+    void stopSimulation() {
+        if (!simulation.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopRequested = true;
+        }
+        wake.notify_one();
+        simulation.join();
+    }
+    
+    void simulationLoop() {
+        Tracer::instance().setThreadName("simulation");
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        while (!stopRequested) {
+            lock.unlock();
+            double now = window.time();
+            update(now);
+            publishSnapshot(now);
+            double wait = clock.secondsToNextTick();
+            lock.lock();
+            keysPublished = keysHandled;
+            published.notify_one();
+            wake.wait_for(lock, std::chrono::duration<double>(wait), [this]() { return wakeRequested || stopRequested; });
+            wakeRequested = false;
+        }
+    }
+    
+    // Waits, for at most KEY_WAIT_SECONDS, until the simulation thread has
+    // published a snapshot with every queued key handled. Without it the
+    // frame after a poll is usually drawn from the snapshot before the
+    // keys, and they show a frame later than on a single thread.
+    void awaitKeys() {
+        TRACE_ZONE("awaitKeys");
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        published.wait_for(lock, std::chrono::duration<double>(KEY_WAIT_SECONDS),
+                           [this]() { return keysPublished == keysQueued; });
+    }
+    
+    // Wakes the simulation thread early, when there is input for it.
+    void wakeSimulation() {
+        if (!simulation.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wakeRequested = true;
+        }
+        wake.notify_one();
+    }
+    
+    // Runs however many fixed ticks have come due since the last call. The
+    // help overlay freezes the game, and after a stall at most a quarter
+    // second is caught up.
+    //
+    // A tick stands for the tick-long interval starting when it comes due,
+    // and each key event is handled just before the tick whose interval it
+    // arrived in. The keys polled at the end of one frame are therefore
+    // spread over the next frame's ticks in the order and spacing they
+    // arrived, rather than all landing on its first tick. Keys that arrive
+    // after the last tick due are handled straight away, which is the same
+    // place in the game as just before the next tick.
+    void update(double currentTime) {
+        TRACE_ZONE("update");
+        uint32_t checksBefore = TraceCounters::thread().collisionChecks;
+        runDueTicks(currentTime);
+        collisionChecks += TraceCounters::thread().collisionChecks - checksBefore;
+    }
+    
+    void runDueTicks(double currentTime) {
+        KeyEvent event;
+        if (helpFrozen) {
+            clock.hold(currentTime);
+            while (keyEvents.pop(event)) {
+                handleKey(event, true);
+            }
+            return;
+        }
+        
+        for (uint32_t requests = restartRequests; restartsHandled != requests; restartsHandled++) {
+            sendInput(INPUT_RESTART);
+            autoRepeat.clear();
+        }
+        
+        clock.advance(currentTime);
+        while (clock.nextTick()) {
+            double tickEnd = clock.tickDueTime() + 1.0 / TICKS_PER_SECOND;
+            while (keyEvents.pop(tickEnd, event)) {
+                handleKey(event, false);
+            }
+            runTick();
+        }
+        while (keyEvents.pop(currentTime, event)) {
+            handleKey(event, false);
+        }
+    }
+    
+    void publishSnapshot(double currentTime) {
+        RenderSnapshot& snapshot = snapshots.back();
+        snapshot.core = core;
+        snapshot.time = currentTime;
+        snapshot.alpha = helpFrozen ? 0.0 : clock.getAlpha();
+        snapshot.tick = tick;
+        snapshot.aiEnabled = aiEnabled;
+        snapshot.aiStats = ai.getStats();
+        snapshot.inputsHandled = latency.lastHandled();
+        snapshot.collisionChecks = collisionChecks;
+        snapshots.publish();
+    }
+    
+    void runTick() {
+        if (!replay && !core.isGameOver() && !core.isPaused()) {
+            autoRepeat.update(core, [this](GameInput input) { sendInput(input); });
+        }
+        if (replay) {
+            replay->applyInputs(core, tick);
+        } else if (aiEnabled) {
+            updateAI();
+        }
+        core.tick();
+        tick++;
+        
+        if (replay && !replayReported && replay->isFinished(tick)) {
+            replayReported = true;
+            std::cout << "Replay finished at tick " << tick << ", score " << core.getScore() << std::endl;
+        }
+    }
+    
+    // Jumps the replay to tick through the file's keyframes.
+    void seekReplay(uint32_t target) {
+        if (!replayFile || !replayFile->seek(core, target)) return;
+        tick = std::min(target, replayFile->getEndTick());
+        replay->seek(tick);
+        replayReported = false;
+    }
+    
+    // Applies an input to the core, recording it if a recording is running.
+    void sendInput(GameInput input) {
+        if (recording) recording->record(tick, input);
+        applyInput(core, input);
+    }
+    
+    // Call once the simulation thread has stopped.
+    void finishRecording() {
+        if (recording) recording->finish(tick, core);
+    }
+    
+    // Plays one input per tick toward the AI's chosen placement, then locks
+    // the piece. Replans whenever the piece is not where the plan left it,
+    // which happens when gravity or the player moves it.
+    void updateAI() {
+        TRACE_ZONE("updateAI");
+        if (core.isGameOver() || core.isPaused()) return;
+        
+        if (!aiPlanned || core.getPiecesPlaced() != aiPiecesPlaced || core.getCurrentPiece() != aiExpected) {
+            Tetromino target;
+            aiPlanned = ai.plan(core, target) && ai.inputsFor(core, target, aiMoves);
+            aiMoveIndex = 0;
+            aiPiecesPlaced = core.getPiecesPlaced();
+            if (!aiPlanned) return;
+        }
+        
+        if (aiMoveIndex < aiMoves.size()) {
+            sendInput((GameInput)aiMoves[aiMoveIndex++]);
+        } else {
+            sendInput(INPUT_STEP);
+            aiPlanned = false;
+        }
+        aiExpected = core.getCurrentPiece();
+    }
+    
+    // What the window's event handlers report. They only queue what
+    // happened; update() and handleInput() act on it.
+    void keyEvent(int key, bool pressed, double time) {
+        if (keyEvents.push(KeyEvent{time, key, pressed})) keysQueued++;
+        wakeSimulation();
+    }
+    
+    // Queued like a key, so keys pressed before the focus went are
+    // released in order.
+    void focusLost(double time) {
+        keyEvent(KEY_FOCUS_LOST, false, time);
+    }
+    
+    void mouseClick() {
+        mouseClicked = true;
+    }
+    
+    void toggleHud() {
+        showHud = !showHud;
+    }
+    
+    void updateMouse() {
+        window.getCursorPos(mouseX, mouseY);
+        
+        bool wasRestartHovered = ui.restartButton.hovered;
+        bool wasHelpHovered = ui.helpButton.hovered;
+        bool wasCloseHelpHovered = ui.closeHelpButton.hovered;
+        
+        ui.restartButton.hovered = ui.restartButton.contains(mouseX, mouseY);
+        ui.helpButton.hovered = ui.helpButton.contains(mouseX, mouseY);
+        ui.closeHelpButton.hovered = ui.showHelp && ui.closeHelpButton.contains(mouseX, mouseY);
+        
+        if (ui.restartButton.hovered != wasRestartHovered || ui.helpButton.hovered != wasHelpHovered) {
+            canvas.invalidate(LAYER_PANEL);
+        }
+        if (ui.closeHelpButton.hovered != wasCloseHelpHovered) {
+            canvas.invalidate(LAYER_HELP);
+        }
+    }
+    
+    // Handles the mouse once per frame. Keys are handled tick by tick in
+    // update().
+    void handleInput() {
+        TRACE_ZONE("handleInput");
+        updateMouse();
+        
+        bool clicked = mouseClicked;
+        mouseClicked = false;
+        if (clicked) {
+            if (ui.restartButton.hovered && !replay) {
+                ui.showHelp = false;
+                helpFrozen = false;
+                restartRequests++;
+                wakeSimulation();
+                return;
+            }
+            if (ui.helpButton.hovered) {
+                ui.showHelp = !ui.showHelp;
+                helpFrozen = ui.showHelp;
+                canvas.invalidate(LAYER_HELP);
+                wakeSimulation();
+                return;
+            }
+            if (ui.closeHelpButton.hovered) {
+                ui.showHelp = false;
+                helpFrozen = false;
+                wakeSimulation();
+                return;
+            }
+        }
+    }
+    
+    // Acts on one key event, just before the tick it belongs to. While the
+    // help overlay has the game frozen only key releases count. Losing the
+    // focus, pausing and restarting drop every held key, so nothing
+    // repeats from a hold that began before them.
+    void handleKey(const KeyEvent& event, bool frozen) {
+        keysHandled++;
+        if (event.key == KEY_FOCUS_LOST) {
+            autoRepeat.clear();
+            return;
+        }
+        GameInput input = keyInput(event.key);
+        if (!event.pressed) {
+            autoRepeat.release(input);
+            return;
+        }
+        
+        if (frozen) return;
+        
+        if (replay) {
+            const uint32_t seekTicks = 10 * TICKS_PER_SECOND;
+            if (event.key == KEY_LEFT) seekReplay(tick > seekTicks ? tick - seekTicks : 0);
+            if (event.key == KEY_RIGHT) seekReplay(tick + seekTicks);
+            return;
+        }
+        
+        switch (event.key) {
+            case KEY_P:
+                sendKeyInput(INPUT_PAUSE, event.time);
+                if (core.isPaused()) autoRepeat.clear();
+                return;
+            case KEY_R:
+                sendKeyInput(INPUT_RESTART, event.time);
+                autoRepeat.clear();
+                return;
+            case KEY_I:
+                aiEnabled = !aiEnabled;
+                aiPlanned = false;
+                return;
+            default:
+                break;
+        }
+        
+        if (input == INPUT_COUNT) return;
+        autoRepeat.press(input);
+        if (core.isGameOver() || core.isPaused()) return;
+        sendKeyInput(input, event.time);
+    }
+    
+    // Sends the input of a press stamped time, which counts toward the
+    // latency figures only if it changed the game: a move into a wall has
+    // nothing to show.
+    void sendKeyInput(GameInput input, double time) {
+        Tetromino piece = core.getCurrentPiece();
+        uint32_t boardVersion = core.getBoardVersion();
+        bool paused = core.isPaused();
+        sendInput(input);
+        if (core.getCurrentPiece() != piece || core.getBoardVersion() != boardVersion || core.isPaused() != paused) {
+            latency.inputHandled(time);
+        }
+    }
+    
+    // Draws the newest snapshot, with the falling piece moved on by the
+    // time since it was taken.
+    void render(double currentTime) {
+        if (snapshots.acquire()) {
+            displayed = snapshots.front();
+        }
+        frameTime = currentTime;
+        double alpha = displayed.alpha + (currentTime - displayed.time) * TICKS_PER_SECOND;
+        scene.render(displayed.core, ui, fallProgress(displayed.core, alpha < 1.0 ? alpha : 1.0));
+    }
+    
+    // Drawn after render() on top of everything, as an overlay since its
+    // text changes every frame.
+    void renderHud(const FrameProfiler& profiler) {
+        TRACE_ZONE("renderHud");
+        if (!showHud) return;
+        
+        float hudColor[3] = {0.0f, 0.0f, 0.0f};
+        float labelColor[3] = {0.0f, 1.0f, 1.0f};
+        float textColor[3] = {1.0f, 1.0f, 1.0f};
+        float hudX = GRID_OFFSET_X + GRID_WIDTH * BLOCK_SIZE + 15;
+        float hudY = GRID_OFFSET_Y;
+        float lineHeight = 16.0f;
+        float pixelSize = 1.8f;
+        
+        int lines = displayed.aiEnabled ? 16 : 13;
+        canvas.overlayRect(hudX, hudY, 255, 10 + lines * lineHeight, hudColor);
+        
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(2);
+        float x = hudX + 8;
+        float y = hudY + 8;
+        
+        canvas.overlayText("FRAME MS", x, y, labelColor, pixelSize);
+        y += lineHeight;
+        line << "P50 " << profiler.frameTimePercentile(0.5) << "  P99 " << profiler.frameTimePercentile(0.99);
+        canvas.overlayText(line.str(), x, y, textColor, pixelSize);
+        y += lineHeight;
+        line.str("");
+        line << "MAX " << profiler.frameTimeMax();
+        canvas.overlayText(line.str(), x, y, textColor, pixelSize);
+        y += lineHeight;
+        line.str("");
+        line << "SNAPSHOT AGE " << (frameTime - displayed.time) * 1000.0;
+        canvas.overlayText(line.str(), x, y, textColor, pixelSize);
+        y += lineHeight;
+        
+        canvas.overlayText("INPUT TO SWAP MS", x, y, labelColor, pixelSize);
+        y += lineHeight;
+        line.str("");
+        const LatencySamples& inputLag = latency.getSwapCallLatencies();
+        line << "P50 " << inputLag.recentPercentile<FrameProfiler::WINDOW>(0.5) / 1000.0
+             << "  P99 " << inputLag.recentPercentile<FrameProfiler::WINDOW>(0.99) / 1000.0;
+        canvas.overlayText(line.str(), x, y, textColor, pixelSize);
+        y += lineHeight;
+        
+        canvas.overlayText("CPU MS PER FRAME", x, y, labelColor, pixelSize);
+        y += lineHeight;
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            line.str("");
+            line << std::left << std::setw(7) << FRAME_PHASE_NAMES[phase] << std::right << profiler.phaseAverage((FramePhase)phase);
+            canvas.overlayText(line.str(), x, y, textColor, pixelSize);
+            y += lineHeight;
+        }
+        
+        line.str("");
+        line << std::setprecision(1) << "DRAWS " << profiler.drawCallsAverage()
+             << "  COLLISIONS " << profiler.collisionChecksAverage();
+        canvas.overlayText(line.str(), x, y, textColor, pixelSize);
+        y += lineHeight;
+        line.str("");
+        line << "KEYS WAITING " << keyEvents.size() << "  DROPPED " << keyEvents.getDropped();
+        canvas.overlayText(line.str(), x, y, textColor, pixelSize);
+        y += lineHeight;
+        
+        if (displayed.aiEnabled) {
+            const AIStats& stats = displayed.aiStats;
+            canvas.overlayText("AI SEARCH", x, y, labelColor, pixelSize);
+            y += lineHeight;
+            line.str("");
+            line << "KNODES/S " << stats.nodesPerSecond() / 1000.0;
+            canvas.overlayText(line.str(), x, y, textColor, pixelSize);
+            y += lineHeight;
+            line.str("");
+            line << "TT HIT " << 100.0 * stats.hitRate() << "  DUP " << 100.0 * stats.duplicateRate();
+            canvas.overlayText(line.str(), x, y, textColor, pixelSize);
+        }
+        
+        canvas.flushOverlay();
+    }
+    
+    // Draw calls issued so far in the current frame.
+    int getFrameDrawCalls() const {
+        return canvas.getFrameDrawCalls();
+    }
+    
+    uint32_t getCollisionChecks() const {
+        return displayed.collisionChecks;
+    }
+    
+    const InputLatencyTracker& getLatency() const {
+        return latency;
+    }
+    
+    bool isGameOver() const {
+        return displayed.core.isGameOver();
+    }
+    
+    bool isPaused() const {
+        return displayed.core.isPaused();
+    }
+    
+    int getScore() const {
+        return displayed.core.getScore();
+    }
+    
+    int getLevel() const {
+        return displayed.core.getLevel();
+    }
+    
+    int getLines() const {
+        return displayed.core.getLines();
+    }
+};
+
+#endif
@@ -0,0 +1,864 @@
+#include "tetrisCore.h"
+#include "tetrisAI.h"
+#include "tetrisBatch.h"
+#include "tetrisPlacement.h"
+#include "tetrisRaster.h"
+#include "tetrisReplay.h"
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+
+using namespace std;
+
+// Plays games with no window as fast as the CPU allows and reports throughput.
+// Each piece gets a random rotation and column, then is hard dropped. With
+// --placements each piece instead goes to a random reachable placement by
+// replaying the input sequence the placement search found for it, and with
+// --ai the beam-search player picks every placement.
+//
+// --batch spreads the games over a work-stealing pool with one worker per
+// core (or --threads N). Game i is seeded with seed + i, so every game
+// plays out the same whatever the thread count, and the summary adds the
+// mean, percentiles and a histogram of each per-game result.
+//
+// --record-dir DIR (which implies --batch) also saves every game as
+// DIR/game-<i>.replay, for building replay corpora.
+//
+// --replay plays back a recording made with the game's --record option at
+// full speed and checks it ends with the recorded score, lines and pieces.
+// Adding --seek T also jumps straight to tick T through the file's keyframe
+// index and checks the state matches the one the full replay passed through.
+//
+// --replay with --render out.png (or .ppm) draws the game on the CPU with
+// the software rasterizer instead, one frame per tick, and writes the last
+// frame; with --seek T it writes the frame at tick T, for thumbnails. It
+// reports frames per second with the layer caches and with every layer
+// redrawn each frame, and checks the redrawn frame matches one drawn
+// through fresh layer buffers.
+//
+// --replay with --check-keyframes writes copies of the file with one field
+// of one keyframe corrupted at a time, such as a level of -9, a
+// piece off the board or a bag of more than seven, and checks that seeking
+// in each copy fails instead of loading it.
+//
+// --check-idle-frames N draws N idle frames with the software rasterizer in
+// each state the window can sit in and checks none re-rendered a layer.
+//
+// --check-drops compares every hard drop distance the board computes with
+// stepping the piece down a row at a time, on each board size.
+//
+// --board 10x20 or 10x40 runs the random player on the standard board or on
+// the tall board with a hidden buffer instead of the usual 15x20 one; with
+// --render out.png it also draws where the last game ended.
+//
+// --randomizer bag deals pieces from shuffled bags of seven instead of
+// picking each one uniformly. --bench-generators times the piece generators
+// against the std::mt19937 path they replaced.
+
+// The player's random choices come from the game seed's second stream, so
+// they never line up with the pieces.
+const uint64_t POLICY_STREAM = 1;
+
+struct RunStats {
+    long long games = 0;
+    long long pieces = 0;
+    long long lines = 0;
+    long long score = 0;
+    long long enumerations = 0;
+    long long placementsFound = 0;
+    long long placementMismatches = 0;
+    double enumerationSeconds = 0.0;
+
+    void add(const RunStats& other) {
+        games += other.games;
+        pieces += other.pieces;
+        lines += other.lines;
+        score += other.score;
+        enumerations += other.enumerations;
+        placementsFound += other.placementsFound;
+        placementMismatches += other.placementMismatches;
+        enumerationSeconds += other.enumerationSeconds;
+    }
+};
+
+struct GameResult {
+    long long score;
+    long long level;
+    long long lines;
+    long long pieces;
+};
+
+// Everything a batch worker reuses from game to game.
+struct BatchWorker {
+    TetrisCore core;
+    Pcg32 policyRng;
+    PlacementFinder finder;
+    TetrisAI ai;
+    RunStats stats;
+};
+
+// Sends inputs to a core the way the window does, so any game can be
+// recorded: each input is stamped with the current tick, and every piece
+// ends with one tick so recordings have ticks to seek by.
+template <typename Core>
+struct BasicGameDriver {
+    Core& core;
+    InputRecording* recording;
+    uint32_t tick;
+
+    BasicGameDriver(Core& core, InputRecording* recording) : core(core), recording(recording), tick(0) {}
+
+    void send(GameInput input) {
+        if (recording) recording->record(tick, input);
+        applyInput(core, input);
+    }
+
+    void endPiece() {
+        core.tick();
+        tick++;
+    }
+
+    void finish(RunStats& stats) {
+        if (recording) recording->finish(tick, core);
+        stats.games++;
+        stats.pieces += core.getPiecesPlaced();
+        stats.lines += core.getLines();
+        stats.score += core.getScore();
+    }
+};
+
+typedef BasicGameDriver<TetrisCore> GameDriver;
+
+template <typename Core>
+void playRandomGame(BasicGameDriver<Core>& driver, Pcg32& policyRng, RunStats& stats) {
+    Core& core = driver.core;
+    uniform_int_distribution<int> rotationDist(0, 3);
+    uniform_int_distribution<int> shiftDist(-Core::WIDTH / 2, Core::WIDTH / 2);
+
+    core.restartGame();
+    while (!core.isGameOver()) {
+        int rotations = rotationDist(policyRng);
+        for (int i = 0; i < rotations; i++) {
+            driver.send(INPUT_ROTATE);
+        }
+
+        int shift = shiftDist(policyRng);
+        for (int i = 0; i < abs(shift); i++) {
+            int x = core.getCurrentPiece().x;
+            driver.send(shift < 0 ? INPUT_LEFT : INPUT_RIGHT);
+            if (core.getCurrentPiece().x == x) break;
+        }
+
+        driver.send(INPUT_HARD_DROP);
+        driver.send(INPUT_STEP);
+        driver.endPiece();
+    }
+    driver.finish(stats);
+}
+
+void playPlacementGame(GameDriver& driver, PlacementFinder& finder, Pcg32& policyRng, RunStats& stats) {
+    TetrisCore& core = driver.core;
+    PlacementMove moves[PlacementFinder::STATE_COUNT];
+
+    core.restartGame();
+    while (!core.isGameOver()) {
+        auto start = chrono::steady_clock::now();
+        int count = finder.find(core);
+        stats.enumerationSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        stats.enumerations++;
+        stats.placementsFound += count;
+        if (count == 0) break;
+
+        const Placement& target = finder.get(uniform_int_distribution<int>(0, count - 1)(policyRng));
+        finder.inputs(target, moves);
+        for (int i = 0; i < target.inputCount; i++) {
+            driver.send((GameInput)moves[i]);
+        }
+
+        if (core.getCurrentPiece() != target.piece) {
+            stats.placementMismatches++;
+        }
+        driver.send(INPUT_HARD_DROP);
+        driver.send(INPUT_STEP);
+        driver.endPiece();
+    }
+    driver.finish(stats);
+}
+
+void playAIGame(GameDriver& driver, TetrisAI& ai, long long maxPieces, RunStats& stats) {
+    TetrisCore& core = driver.core;
+    vector<PlacementMove> moves;
+
+    core.restartGame();
+    while (!core.isGameOver() && core.getPiecesPlaced() < maxPieces) {
+        Tetromino target;
+        if (!ai.plan(core, target) || !ai.inputsFor(core, target, moves)) break;
+        for (PlacementMove move : moves) {
+            driver.send((GameInput)move);
+        }
+        driver.send(INPUT_STEP);
+        driver.endPiece();
+    }
+    driver.finish(stats);
+}
+
+bool sameState(const TetrisCore& a, const TetrisCore& b) {
+    uint8_t cellsA[GRID_HEIGHT][GRID_WIDTH];
+    uint8_t cellsB[GRID_HEIGHT][GRID_WIDTH];
+    a.copyCells(&cellsA[0][0]);
+    b.copyCells(&cellsB[0][0]);
+    return a.getScore() == b.getScore() && a.getLines() == b.getLines() &&
+           a.getPiecesPlaced() == b.getPiecesPlaced() && a.getCurrentPiece() == b.getCurrentPiece() &&
+           a.getNextPiece() == b.getNextPiece() && a.isGameOver() == b.isGameOver() &&
+           memcmp(cellsA, cellsB, sizeof(cellsA)) == 0;
+}
+
+int replayFile(const char* path, long long seekTick) {
+    ReplayFile file;
+    InputRecording recording;
+    if (!file.open(path) || !file.readRecording(recording)) {
+        cerr << "Failed to load replay " << path << endl;
+        return 1;
+    }
+
+    TetrisCore core(recording.seed, recording.randomizer);
+    auto start = chrono::steady_clock::now();
+    bool matched = replayToEnd(recording, core);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double minutes = (double)recording.endTick / TICKS_PER_SECOND / 60;
+    cout << "seed:         " << recording.seed << " (" << randomizerName(recording.randomizer) << " pieces)" << endl;
+    cout << "inputs:       " << recording.events.size() << endl;
+    cout << "ticks:        " << recording.endTick << " (" << minutes * 60 << " s of play)" << endl;
+    cout << "file size:    " << file.getSize() << " bytes, " << file.getChunkCount() << " keyframes, "
+         << (minutes > 0 ? file.getSize() / minutes : 0.0) << " bytes/min" << endl;
+    cout << "score:        " << core.getScore() << " (recorded " << recording.finalScore << ")" << endl;
+    cout << "lines:        " << core.getLines() << " (recorded " << recording.finalLines << ")" << endl;
+    cout << "pieces:       " << core.getPiecesPlaced() << " (recorded " << recording.finalPieces << ")" << endl;
+    cout << "elapsed (s):  " << elapsed << endl;
+    cout << "ticks/sec:    " << (elapsed > 0 ? recording.endTick / elapsed : 0.0) << endl;
+    cout << (matched ? "replay matches the recording" : "replay DIFFERS from the recording") << endl;
+
+    if (seekTick >= 0) {
+        uint32_t tick = (uint32_t)min(seekTick, (long long)recording.endTick);
+        TetrisCore seeked(recording.seed, recording.randomizer);
+        start = chrono::steady_clock::now();
+        bool ok = file.seek(seeked, tick);
+        double seekSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        TetrisCore expected(recording.seed, recording.randomizer);
+        ReplayPlayer player(recording);
+        for (uint32_t t = 0; t < tick; t++) {
+            player.applyInputs(expected, t);
+            expected.tick();
+        }
+        ok = ok && sameState(seeked, expected);
+        cout << "seek:         tick " << tick << " in " << seekSeconds * 1e6 << " us, score " << seeked.getScore()
+             << ", lines " << seeked.getLines() << (ok ? ", matches the full replay" : ", DIFFERS from the full replay") << endl;
+        matched = matched && ok;
+    }
+    return matched ? 0 : 2;
+}
+
+// The PieceGenerator fields in the order it stores them, for corrupting its
+// bag and randomizer in a saved keyframe.
+struct GeneratorFields {
+    uint64_t state;
+    uint32_t bag;
+    uint8_t randomizer;
+    uint8_t bagLeft;
+};
+static_assert(sizeof(GeneratorFields) == sizeof(PieceGenerator), "GeneratorFields must mirror PieceGenerator");
+
+struct KeyframeCorruption {
+    const char* name;
+    void (*apply)(ReplayKeyframe& keyframe, GeneratorFields& pieces, uint8_t* firstRow);
+    // Changes the first stored row, which a keyframe of an empty board has
+    // none of.
+    bool needsRows;
+};
+
+const KeyframeCorruption KEYFRAME_CORRUPTIONS[] = {
+    {"level 0", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.level = 0; }, false},
+    {"level -9", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.level = -9; }, false},
+    {"level above the lines cleared", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.level = k.linesCleared / 10 + 2; }, false},
+    {"negative lines", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.linesCleared = -1; }, false},
+    {"negative ticksSinceFall", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.ticksSinceFall = -1; }, false},
+    {"ticksSinceFall past a byte", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.ticksSinceFall = 300; }, false},
+    {"piece type 9", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.currentPiece.type = 9; }, false},
+    {"rotation 4", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.currentPiece.rotation = 4; }, false},
+    {"piece x 100", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.currentPiece.x = 100; }, false},
+    {"piece x -10", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.currentPiece.x = -10; }, false},
+    {"piece y 100", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.currentPiece.y = 100; }, false},
+    {"piece y -100", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.currentPiece.y = -100; }, false},
+    {"next piece x 100", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.nextPiece.x = 100; }, false},
+    {"next piece y -100", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.nextPiece.y = -100; }, false},
+    {"next piece type -1", [](ReplayKeyframe& k, GeneratorFields&, uint8_t*) { k.nextPiece.type = -1; }, false},
+    {"bagLeft 200", [](ReplayKeyframe&, GeneratorFields& g, uint8_t*) { g.bagLeft = 200; }, false},
+    {"bagLeft 8", [](ReplayKeyframe&, GeneratorFields& g, uint8_t*) { g.bagLeft = 8; }, false},
+    {"bag entry 7", [](ReplayKeyframe&, GeneratorFields& g, uint8_t*) { g.bag |= 7u << PieceGenerator::BAG_BITS; }, false},
+    {"bag of seven T pieces", [](ReplayKeyframe&, GeneratorFields& g, uint8_t*) {
+        g.bag = 0;
+        for (int i = 0; i < PIECE_TYPES; i++) g.bag |= 2u << (i * PieceGenerator::BAG_BITS);
+        g.bagLeft = PIECE_TYPES;
+    }, false},
+    {"bag bits past the bag", [](ReplayKeyframe&, GeneratorFields& g, uint8_t*) { g.bag |= 1u << 30; }, false},
+    {"randomizer 5", [](ReplayKeyframe&, GeneratorFields& g, uint8_t*) { g.randomizer = 5; }, false},
+    {"cell value 9", [](ReplayKeyframe&, GeneratorFields&, uint8_t* row) { row[0] = 0x99; }, true},
+};
+
+bool writeBytes(const string& path, const vector<uint8_t>& bytes) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && ok;
+}
+
+// Corrupts the keyframe with the most stored rows in the replay at path one
+// way at a time and checks that seeking into its chunk fails for every copy,
+// after checking the untouched copy seeks.
+int checkCorruptKeyframes(const char* path) {
+    ReplayFile file;
+    if (!file.open(path)) {
+        cerr << "Failed to load replay " << path << endl;
+        return 1;
+    }
+    vector<uint8_t> original(file.getSize());
+    FILE* in = fopen(path, "rb");
+    bool read = in && fread(original.data(), 1, original.size(), in) == original.size();
+    if (in) fclose(in);
+    if (!read) {
+        cerr << "Failed to read " << path << endl;
+        return 1;
+    }
+    uint32_t chunk = 0;
+    for (uint32_t i = 1; i < file.getChunkCount(); i++) {
+        if (original[file.getIndexEntry(i).offset + offsetof(ReplayKeyframe, stackRows)] >
+            original[file.getIndexEntry(chunk).offset + offsetof(ReplayKeyframe, stackRows)]) chunk = i;
+    }
+    size_t offset = file.getIndexEntry(chunk).offset;
+    uint32_t tick = chunk * file.getKeyframeInterval();
+    ReplayKeyframe keyframe;
+    memcpy(&keyframe, &original[offset], sizeof(keyframe));
+    bool hasRows = keyframe.stackRows > 0;
+    file.close();
+
+    string corruptPath = string(path) + ".corrupt";
+    auto seeks = [&](const vector<uint8_t>& bytes) {
+        ReplayFile copy;
+        TetrisCore core;
+        return writeBytes(corruptPath, bytes) && copy.open(corruptPath.c_str()) && copy.seek(core, tick);
+    };
+
+    int failures = 0;
+    if (!seeks(original)) {
+        cout << "untouched copy: FAILS to seek" << endl;
+        failures++;
+    }
+    for (const KeyframeCorruption& corruption : KEYFRAME_CORRUPTIONS) {
+        if (corruption.needsRows && !hasRows) {
+            cout << corruption.name << ": skipped, no keyframe has rows" << endl;
+            continue;
+        }
+        vector<uint8_t> bytes = original;
+        ReplayKeyframe corrupt = keyframe;
+        GeneratorFields pieces;
+        memcpy(&pieces, (const void*)&corrupt.pieces, sizeof(pieces));
+        corruption.apply(corrupt, pieces, &bytes[offset + sizeof(ReplayKeyframe)]);
+        memcpy((void*)&corrupt.pieces, &pieces, sizeof(pieces));
+        memcpy(&bytes[offset], &corrupt, sizeof(corrupt));
+        bool accepted = seeks(bytes);
+        cout << corruption.name << ": " << (accepted ? "ACCEPTED" : "rejected") << endl;
+        if (accepted) failures++;
+    }
+    remove(corruptPath.c_str());
+    cout << (failures ? "corrupt keyframes were loaded" : "every corrupt keyframe was rejected") << endl;
+    return failures ? 2 : 0;
+}
+
+int renderReplay(const char* path, const char* outPath, long long seekTick) {
+    ReplayFile file;
+    InputRecording recording;
+    if (!file.open(path) || !file.readRecording(recording)) {
+        cerr << "Failed to load replay " << path << endl;
+        return 1;
+    }
+
+    SoftwareCanvas canvas;
+    TetrisScene<SoftwareCanvas> scene(canvas);
+    SceneUi ui;
+    TetrisCore core(recording.seed, recording.randomizer);
+    long long frames = 0;
+    auto start = chrono::steady_clock::now();
+
+    if (seekTick >= 0) {
+        uint32_t tick = (uint32_t)min(seekTick, (long long)recording.endTick);
+        if (!file.seek(core, tick)) {
+            cerr << "Failed to seek to tick " << tick << endl;
+            return 1;
+        }
+        scene.render(core, ui, fallProgress(core, 0.0));
+        frames = 1;
+    } else {
+        ReplayPlayer player(recording);
+        for (uint32_t tick = 0; tick < recording.endTick; tick++) {
+            player.applyInputs(core, tick);
+            core.tick();
+            scene.render(core, ui, fallProgress(core, 0.0));
+            frames++;
+        }
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    bool written = canvas.getFrame().write(outPath);
+    int boardRenders = canvas.getLayerRenderCount(LAYER_BOARD);
+    int panelRenders = canvas.getLayerRenderCount(LAYER_PANEL);
+
+    // The same last frame again with no caching, as a frame that changes
+    // everywhere would cost.
+    const long long fullFrames = 1000;
+    long long copiedBefore = canvas.getPixelsCopied();
+    long long filledBefore = canvas.getPixelsFilled();
+    auto fullStart = chrono::steady_clock::now();
+    for (long long i = 0; i < fullFrames; i++) {
+        for (int layer = 0; layer < LAYER_COUNT; layer++) {
+            canvas.invalidate((Layer)layer);
+        }
+        scene.render(core, ui, fallProgress(core, 0.0));
+    }
+    double fullElapsed = chrono::duration<double>(chrono::steady_clock::now() - fullStart).count();
+
+    // Frames that redraw every layer go straight onto the frame, so check
+    // the result against the same state drawn through fresh layer buffers.
+    SoftwareCanvas layered;
+    TetrisScene<SoftwareCanvas> layeredScene(layered);
+    layeredScene.render(core, ui, fallProgress(core, 0.0));
+    bool matches = layered.getFrame() == canvas.getFrame();
+
+    cout << "frames:       " << frames << " at " << WINDOW_WIDTH << "x" << WINDOW_HEIGHT << endl;
+    cout << "elapsed (s):  " << elapsed << endl;
+    cout << "frames/sec:   " << (elapsed > 0 ? frames / elapsed : 0.0) << endl;
+    cout << "layer renders: board " << boardRenders << ", panel " << panelRenders << endl;
+    cout << "pixels/frame: " << (double)filledBefore / frames << " filled, "
+         << (double)copiedBefore / frames << " copied" << endl;
+    cout << "full redraw:  " << (fullElapsed > 0 ? fullFrames / fullElapsed : 0.0) << " frames/sec, "
+         << (double)(canvas.getPixelsFilled() - filledBefore) / fullFrames << " filled and "
+         << (double)(canvas.getPixelsCopied() - copiedBefore) / fullFrames << " copied per frame" << endl;
+    if (!matches) {
+        cerr << "Redrawn frame differs from the layered one" << endl;
+        return 1;
+    }
+    if (!written) {
+        cerr << "Failed to write " << outPath << endl;
+        return 1;
+    }
+    cout << "wrote " << outPath << endl;
+    return 0;
+}
+
+// Random play on a board other than TetrisCore's.
+template <typename Core>
+int runBoardVariant(long long games, unsigned int seed, PieceRandomizer randomizer, const char* renderPath) {
+    RunStats stats;
+    Core core(seed, randomizer);
+    Pcg32 policyRng(seed, POLICY_STREAM);
+    BasicGameDriver<Core> driver(core, NULL);
+
+    auto start = chrono::steady_clock::now();
+    for (long long i = 0; i < games; i++) {
+        playRandomGame(driver, policyRng, stats);
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "board:        " << Core::WIDTH << "x" << Core::HEIGHT << ", " << Core::VISIBLE_HEIGHT << " rows shown, "
+         << sizeof(typename Core::Board::Row) * 8 << "-bit rows" << endl;
+    cout << "games:        " << stats.games << endl;
+    cout << "pieces:       " << stats.pieces << endl;
+    cout << "lines:        " << stats.lines << endl;
+    cout << "mean score:   " << (stats.games ? (double)stats.score / stats.games : 0.0) << endl;
+    cout << "elapsed (s):  " << elapsed << endl;
+    cout << "games/sec:    " << (elapsed > 0 ? stats.games / elapsed : 0.0) << endl;
+    cout << "pieces/sec:   " << (elapsed > 0 ? stats.pieces / elapsed : 0.0) << endl;
+
+    if (renderPath) {
+        SoftwareCanvas canvas;
+        TetrisScene<SoftwareCanvas> scene(canvas);
+        SceneUi ui;
+        scene.render(core, ui);
+        if (!canvas.getFrame().write(renderPath)) {
+            cerr << "Failed to write " << renderPath << endl;
+            return 1;
+        }
+        cout << "wrote " << renderPath << endl;
+    }
+    return 0;
+}
+
+// Positions on board where dropDistance() disagrees with stepping the piece
+// down a row at a time with collides(), over every type, rotation, x and y
+// from TOP rows above the field down that does not already collide.
+template <typename Board>
+long long countDropMismatches(const Board& board) {
+    long long mismatches = 0;
+    for (int type = 0; type < PIECE_TYPES; type++) {
+        for (int rot = 0; rot < PIECE_ROTATIONS; rot++) {
+            const PieceRotation& shape = pieceRotation(type, rot);
+            for (int x = -Board::WALL; x < Board::WIDTH; x++) {
+                for (int y = -Board::TOP; y < Board::HEIGHT; y++) {
+                    if (board.collides(shape.rows, x, y)) continue;
+                    int steps = 0;
+                    while (!board.collides(shape.rows, x, y + steps + 1)) steps++;
+                    if (board.dropDistance(shape.rows, shape.bottoms, x, y) != steps) mismatches++;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+// Checks hard drop distances on the empty board and on the board before
+// every piece of a few random games. Returns 1 on a mismatch.
+template <typename Core>
+int checkDropDistances(unsigned int seed, int games) {
+    Core core(seed, RANDOMIZER_UNIFORM);
+    Pcg32 policyRng(seed, POLICY_STREAM);
+    uniform_int_distribution<int> rotationDist(0, 3);
+    uniform_int_distribution<int> shiftDist(-Core::WIDTH / 2, Core::WIDTH / 2);
+
+    long long boards = 1;
+    long long mismatches = countDropMismatches(typename Core::Board());
+    for (int g = 0; g < games; g++) {
+        core.restartGame();
+        while (!core.isGameOver()) {
+            mismatches += countDropMismatches(core.getBoard());
+            boards++;
+            for (int i = rotationDist(policyRng); i > 0; i--) {
+                applyInput(core, INPUT_ROTATE);
+            }
+            int shift = shiftDist(policyRng);
+            for (int i = 0; i < abs(shift); i++) {
+                applyInput(core, shift < 0 ? INPUT_LEFT : INPUT_RIGHT);
+            }
+            applyInput(core, INPUT_HARD_DROP);
+            applyInput(core, INPUT_STEP);
+        }
+    }
+
+    cout << Core::WIDTH << "x" << Core::HEIGHT << ": " << mismatches << " drop distance mismatches over "
+         << boards << " boards" << endl;
+    return mismatches ? 1 : 0;
+}
+
+struct GeneratorBench {
+    const char* name;
+    size_t stateBytes;
+    double drawSeconds;
+    double seedSeconds;
+    long long counts[PIECE_TYPES];
+    // Most pieces dealt between two of the same type.
+    long long longestGap;
+};
+
+// Times draws pieces from a Generator built by make(seed), and reseeds of one.
+// Generator provides next() and seed(s).
+template <typename Generator, typename Make>
+GeneratorBench benchGenerator(const char* name, long long draws, long long seeds, unsigned int seed, Make make) {
+    GeneratorBench bench = {name, sizeof(Generator), 0.0, 0.0, {}, 0};
+    Generator generator = make(seed);
+    long long lastSeen[PIECE_TYPES];
+    for (int type = 0; type < PIECE_TYPES; type++) {
+        lastSeen[type] = -1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (long long i = 0; i < draws; i++) {
+        int type = generator.next();
+        bench.counts[type]++;
+        bench.longestGap = max(bench.longestGap, i - lastSeen[type] - 1);
+        lastSeen[type] = i;
+    }
+    bench.drawSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    long long checksum = 0;
+    start = chrono::steady_clock::now();
+    for (long long i = 0; i < seeds; i++) {
+        generator.seed(seed + (unsigned int)i);
+        checksum += generator.next();
+    }
+    bench.seedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (checksum < 0) cout << checksum;
+    return bench;
+}
+
+// What TetrisCore drew pieces from before PieceGenerator.
+struct Mt19937Pieces {
+    mt19937 rng;
+    uniform_int_distribution<int> shapeDist;
+
+    explicit Mt19937Pieces(unsigned int seed) : rng(seed), shapeDist(0, PIECE_TYPES - 1) {}
+
+    void seed(unsigned int seedValue) {
+        rng.seed(seedValue);
+        shapeDist.reset();
+    }
+
+    int next() {
+        return shapeDist(rng);
+    }
+};
+
+int runGeneratorBench(unsigned int seed) {
+    const long long draws = 50000000;
+    const long long seeds = 1000000;
+    GeneratorBench benches[3] = {
+        benchGenerator<Mt19937Pieces>("mt19937 uniform", draws, seeds, seed,
+                                      [](unsigned int s) { return Mt19937Pieces(s); }),
+        benchGenerator<PieceGenerator>("pcg32 uniform  ", draws, seeds, seed,
+                                       [](unsigned int s) { return PieceGenerator(s, RANDOMIZER_UNIFORM); }),
+        benchGenerator<PieceGenerator>("pcg32 7-bag    ", draws, seeds, seed,
+                                       [](unsigned int s) { return PieceGenerator(s, RANDOMIZER_BAG); }),
+    };
+
+    cout << "draws:        " << draws << ", reseeds: " << seeds << endl;
+    cout << "TetrisCore:   " << sizeof(TetrisCore) << " bytes" << endl;
+    for (const GeneratorBench& bench : benches) {
+        long long fewest = bench.counts[0], most = bench.counts[0];
+        for (long long count : bench.counts) {
+            fewest = min(fewest, count);
+            most = max(most, count);
+        }
+        cout << bench.name << " " << bench.stateBytes << " bytes, "
+             << bench.drawSeconds * 1e9 / draws << " ns/piece, "
+             << bench.seedSeconds * 1e9 / seeds << " ns/reseed, piece share "
+             << 100.0 * fewest / draws << "-" << 100.0 * most / draws << "%, longest gap "
+             << bench.longestGap << endl;
+    }
+    return 0;
+}
+
+void printDistribution(const char* name, const Distribution& d) {
+    cout << name << "mean " << d.mean << ", min " << d.min << ", p50 " << d.p50
+         << ", p90 " << d.p90 << ", p99 " << d.p99 << ", max " << d.max << endl;
+
+    long long largest = 1;
+    for (long long bucket : d.buckets) {
+        largest = max(largest, bucket);
+    }
+    for (int i = 0; i < Distribution::HISTOGRAM_BUCKETS; i++) {
+        long long low = d.min + i * d.bucketWidth;
+        if (low > d.max) break;
+        cout << "  " << low << "-" << low + d.bucketWidth - 1 << "\t" << d.buckets[i] << "\t"
+             << string((size_t)(40 * d.buckets[i] / largest), '#') << endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    long long games = 100000;
+    unsigned int seed = 1;
+    bool placements = false;
+    bool useAI = false;
+    long long maxPieces = 10000;
+    bool batch = false;
+    int threads = 0;
+    const char* replayPath = NULL;
+    long long seekTick = -1;
+    const char* renderPath = NULL;
+    const char* boardSize = "15x20";
+    PieceRandomizer randomizer = RANDOMIZER_UNIFORM;
+    bool benchGenerators = false;
+    bool checkKeyframes = false;
+    bool checkDrops = false;
+    int idleFrames = 0;
+    const char* recordDir = NULL;
+    AIConfig aiConfig;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            games = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--placements") == 0) {
+            placements = true;
+        } else if (strcmp(argv[i], "--ai") == 0) {
+            useAI = true;
+        } else if (strcmp(argv[i], "--beam") == 0 && i + 1 < argc) {
+            aiConfig.beamWidth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            aiConfig.depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-pieces") == 0 && i + 1 < argc) {
+            maxPieces = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--seek") == 0 && i + 1 < argc) {
+            seekTick = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--randomizer") == 0 && i + 1 < argc && parseRandomizer(argv[i + 1], randomizer)) {
+            i++;
+        } else if (strcmp(argv[i], "--check-keyframes") == 0) {
+            checkKeyframes = true;
+        } else if (strcmp(argv[i], "--check-idle-frames") == 0 && i + 1 < argc) {
+            idleFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--check-drops") == 0) {
+            checkDrops = true;
+        } else if (strcmp(argv[i], "--bench-generators") == 0) {
+            benchGenerators = true;
+        } else if (strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            boardSize = argv[++i];
+        } else if (strcmp(argv[i], "--render") == 0 && i + 1 < argc) {
+            renderPath = argv[++i];
+        } else if (strcmp(argv[i], "--record-dir") == 0 && i + 1 < argc) {
+            recordDir = argv[++i];
+            batch = true;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else {
+            cerr << "Usage: " << argv[0] << " [--games N] [--seed S] [--randomizer uniform|bag] [--placements]"
+                 << " [--ai [--beam W] [--depth D] [--max-pieces N]]"
+                 << " [--batch [--threads N] [--record-dir DIR]]"
+                 << " [--replay game.replay [--seek T] [--render out.png] [--check-keyframes]]"
+                 << " [--board 10x20|15x20|10x40 [--render out.png]] [--check-idle-frames N] [--check-drops] [--bench-generators]" << endl;
+            return 1;
+        }
+    }
+
+    if (benchGenerators) {
+        return runGeneratorBench(seed);
+    }
+    if (idleFrames > 0) {
+        SoftwareCanvas canvas;
+        int failures = checkIdleFrames<TetrisCore>(canvas, idleFrames, cout);
+        cout << (failures ? "idle frames re-rendered layers" : "no idle frame re-rendered a layer") << endl;
+        return failures ? 2 : 0;
+    }
+    if (checkDrops) {
+        int failures = checkDropDistances<StandardTetrisCore>(seed, 20);
+        failures += checkDropDistances<TetrisCore>(seed, 20);
+        failures += checkDropDistances<TallTetrisCore>(seed, 20);
+        return failures ? 2 : 0;
+    }
+    if (strcmp(boardSize, "15x20") != 0) {
+        if (useAI || placements || batch || replayPath) {
+            cerr << "--board only runs random play; the AI, placement search, batches and replays use 15x20" << endl;
+            return 1;
+        }
+        if (strcmp(boardSize, "10x20") == 0) return runBoardVariant<StandardTetrisCore>(games, seed, randomizer, renderPath);
+        if (strcmp(boardSize, "10x40") == 0) return runBoardVariant<TallTetrisCore>(games, seed, randomizer, renderPath);
+        cerr << "Unknown board size " << boardSize << "; expected 10x20, 15x20 or 10x40" << endl;
+        return 1;
+    }
+
+    if (replayPath && checkKeyframes) {
+        return checkCorruptKeyframes(replayPath);
+    }
+    if (replayPath && renderPath) {
+        return renderReplay(replayPath, renderPath, seekTick);
+    }
+    if (replayPath) {
+        return replayFile(replayPath, seekTick);
+    }
+
+    RunStats stats;
+    AIStats aiStats;
+    WorkStealingPool pool(batch ? threads : 1);
+    vector<unique_ptr<BatchWorker>> workers;
+    for (int w = 0; w < pool.getThreadCount(); w++) {
+        workers.emplace_back(new BatchWorker());
+        workers.back()->core.setRandomizer(randomizer);
+        workers.back()->ai.setConfig(aiConfig);
+    }
+    vector<GameResult> results(batch ? (size_t)games : 0);
+    if (recordDir) {
+        error_code error;
+        filesystem::create_directories(recordDir, error);
+    }
+    atomic<long long> recordFailures(0);
+
+    auto playGame = [&](BatchWorker& worker, InputRecording* recording) {
+        GameDriver driver(worker.core, recording);
+        if (useAI) {
+            playAIGame(driver, worker.ai, maxPieces, worker.stats);
+        } else if (placements) {
+            playPlacementGame(driver, worker.finder, worker.policyRng, worker.stats);
+        } else {
+            playRandomGame(driver, worker.policyRng, worker.stats);
+        }
+    };
+
+    auto start = chrono::steady_clock::now();
+    if (batch) {
+        pool.run(games, [&](long long i, int w) {
+            BatchWorker& worker = *workers[w];
+            TetrisCore& core = worker.core;
+            unsigned int gameSeed = seed + (unsigned int)i;
+            core.reseed(gameSeed);
+            worker.policyRng.seed(gameSeed, POLICY_STREAM);
+            if (recordDir) {
+                InputRecording recording(gameSeed, randomizer);
+                playGame(worker, &recording);
+                string path = string(recordDir) + "/game-" + to_string(i) + ".replay";
+                if (!recording.save(path.c_str())) recordFailures++;
+            } else {
+                playGame(worker, NULL);
+            }
+            results[i] = GameResult{core.getScore(), core.getLevel(), core.getLines(), core.getPiecesPlaced()};
+        });
+    } else {
+        BatchWorker& worker = *workers[0];
+        worker.core.reseed(seed);
+        worker.policyRng.seed(seed, POLICY_STREAM);
+        for (long long i = 0; i < games; i++) {
+            playGame(worker, NULL);
+        }
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    for (const unique_ptr<BatchWorker>& worker : workers) {
+        stats.add(worker->stats);
+        aiStats.add(worker->ai.getStats());
+    }
+
+    cout << "games:        " << stats.games << endl;
+    cout << "pieces:       " << stats.pieces << endl;
+    cout << "lines:        " << stats.lines << endl;
+    cout << "mean score:   " << (stats.games ? (double)stats.score / stats.games : 0.0) << endl;
+    cout << "elapsed (s):  " << elapsed << endl;
+    cout << "games/sec:    " << (elapsed > 0 ? stats.games / elapsed : 0.0) << endl;
+    cout << "pieces/sec:   " << (elapsed > 0 ? stats.pieces / elapsed : 0.0) << endl;
+    if (recordDir) {
+        cout << "recorded:     " << games - recordFailures << " replays in " << recordDir << endl;
+        if (recordFailures) cerr << "Failed to write " << recordFailures << " replays" << endl;
+    }
+    if (batch) {
+        cout << "threads:      " << pool.getThreadCount() << endl;
+        cout << "steals:       " << pool.getSteals() << endl;
+
+        vector<long long> values(results.size());
+        const char* names[4] = {"score:        ", "level:        ", "lines:        ", "pieces:       "};
+        long long GameResult::*fields[4] = {&GameResult::score, &GameResult::level, &GameResult::lines, &GameResult::pieces};
+        for (int f = 0; f < 4; f++) {
+            for (size_t i = 0; i < results.size(); i++) {
+                values[i] = results[i].*fields[f];
+            }
+            printDistribution(names[f], Distribution::of(values));
+        }
+    }
+    if (placements) {
+        cout << "placements:   " << (stats.enumerations ? (double)stats.placementsFound / stats.enumerations : 0.0) << " per piece" << endl;
+        cout << "searches/sec: " << (stats.enumerationSeconds > 0 ? stats.enumerations / stats.enumerationSeconds : 0.0) << endl;
+        cout << "mismatches:   " << stats.placementMismatches << endl;
+    }
+    if (useAI) {
+        const AIConfig& config = workers[0]->ai.getConfig();
+        cout << "beam, depth:  " << config.beamWidth << ", " << config.depth << endl;
+        cout << "nodes/sec:    " << aiStats.nodesPerSecond() << endl;
+        cout << "nodes/piece:  " << (aiStats.searches ? (double)aiStats.nodes / aiStats.searches : 0.0) << endl;
+        cout << "table hits:   " << 100.0 * aiStats.hitRate() << "%" << endl;
+        cout << "duplicates:   " << 100.0 * aiStats.duplicateRate() << "%" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include "tetrisGame.h"
+#include "tetrisLatency.h"
+#include "tetrisRandom.h"
+#include "tetrisRaster.h"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Runs the game's real main loop, TetrisGame::run(), against a mock window
+// with no display, injects synthetic key presses and reports how long each
+// took to reach the screen:
+//
+//   tetrisInject [--mode threaded|single|both] [--presses N] [--rate R]
+//                [--hz HZ] [--swap-ms MS] [--seed S] [--out report.json]
+//
+// The presses are --rate a second on average, spaced between half and one
+// and a half times the mean gap apart, each an arrow key held briefly. They
+// are stamped with the time they are pressed but, as with a real window,
+// only reach the game when the loop next polls for events.
+//
+// The window runs on the steady clock. Its swap sleeps for --swap-ms, the
+// driver's share of a frame, then until the next vertical blank of a
+// --hz display; --hz 0 is a swap interval of 0. Frames are drawn through
+// NullCanvas, so the CPU work of drawing is real and nothing is rasterized.
+//
+// Each mode prints two histograms, from the press to the swap call that
+// first showed it and to that swap's return, and --out writes them as
+// JSON. Presses that change nothing, such as a move into a wall, are not
+// measured; the exit status is 1 if any other press went unmeasured.
+
+// Time after the last press before the window closes, for it to be shown.
+const double SETTLE_SECONDS = 0.25;
+
+class MockWindow;
+typedef TetrisGame<MockWindow, NullCanvas> MockGame;
+
+class MockWindow {
+private:
+    typedef chrono::steady_clock Clock;
+
+    Clock::time_point start;
+    const vector<KeyEvent>& keys;
+    size_t nextKey;
+    double vsyncPeriod;
+    double swapSeconds;
+    MockGame* game;
+
+    Clock::time_point at(double seconds) const {
+        return start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(seconds));
+    }
+
+public:
+    // hz 0 swaps without waiting for a vertical blank.
+    MockWindow(const vector<KeyEvent>& keys, double hz, double swapMs)
+        : start(Clock::now()), keys(keys), nextKey(0), vsyncPeriod(hz > 0.0 ? 1.0 / hz : 0.0),
+          swapSeconds(swapMs / 1000.0), game(NULL) {}
+
+    void attach(MockGame* receiver) {
+        game = receiver;
+    }
+
+    double time() const {
+        return chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Off the window, so no button is ever hovered.
+    void getCursorPos(double& x, double& y) const {
+        x = -1.0;
+        y = -1.0;
+    }
+
+    bool shouldClose() const {
+        return nextKey == keys.size() && time() > (keys.empty() ? 0.0 : keys.back().time) + SETTLE_SECONDS;
+    }
+
+    void swapBuffers() {
+        TRACE_ZONE("swapBuffers");
+        double done = time() + swapSeconds;
+        if (vsyncPeriod > 0.0) done = (double)(long long)(done / vsyncPeriod + 1.0) * vsyncPeriod;
+        this_thread::sleep_until(at(done));
+    }
+
+    void pollEvents();
+};
+
+void MockWindow::pollEvents() {
+    TRACE_ZONE("pollEvents");
+    double now = time();
+    while (nextKey < keys.size() && keys[nextKey].time <= now) {
+        const KeyEvent& key = keys[nextKey++];
+        game->keyEvent(key.key, key.pressed, key.time);
+    }
+}
+
+// presses arrow-key presses and their releases, in time order. No two
+// overlap: each is held for 10-40% of the mean gap, and the shortest gap
+// is half of it.
+vector<KeyEvent> syntheticKeys(int presses, double rate, unsigned int seed) {
+    const int arrows[] = {KEY_LEFT, KEY_RIGHT, KEY_UP, KEY_DOWN};
+    Pcg32 random(seed, 1);
+    vector<KeyEvent> keys;
+    double meanGap = 1.0 / rate;
+    double time = 0.5;
+    for (int i = 0; i < presses; i++) {
+        time += meanGap * (0.5 + random.bounded(1000) / 1000.0);
+        int key = arrows[random.bounded(4)];
+        double hold = meanGap * (0.1 + 0.3 * random.bounded(1000) / 1000.0);
+        keys.push_back(KeyEvent{time, key, true});
+        keys.push_back(KeyEvent{time + hold, key, false});
+    }
+    return keys;
+}
+
+int main(int argc, char** argv) {
+    string mode = "both";
+    int presses = 200;
+    double rate = 20.0;
+    double hz = 60.0;
+    double swapMs = 0.0;
+    unsigned int seed = 1;
+    const char* outPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (strcmp(argv[i], "--presses") == 0 && i + 1 < argc) {
+            presses = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--hz") == 0 && i + 1 < argc) {
+            hz = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--swap-ms") == 0 && i + 1 < argc) {
+            swapMs = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--mode threaded|single|both] [--presses N] [--rate R]"
+                 << " [--hz HZ] [--swap-ms MS] [--seed S] [--out report.json]" << endl;
+            return -1;
+        }
+    }
+    if ((mode != "threaded" && mode != "single" && mode != "both") || presses < 1 || rate <= 0.0) {
+        cerr << "Expected --mode threaded, single or both, --presses of at least 1 and a positive --rate" << endl;
+        return -1;
+    }
+
+    vector<KeyEvent> keys = syntheticKeys(presses, rate, seed);
+    vector<bool> singleThreadModes;
+    if (mode != "single") singleThreadModes.push_back(false);
+    if (mode != "threaded") singleThreadModes.push_back(true);
+
+    ostringstream runs;
+    bool allMeasured = true;
+    cout << fixed << setprecision(2);
+    for (size_t m = 0; m < singleThreadModes.size(); m++) {
+        bool singleThread = singleThreadModes[m];
+        const char* name = singleThread ? "single" : "threaded";
+        MockWindow window(keys, hz, swapMs);
+        MockGame game(window, seed, RANDOMIZER_UNIFORM, InputTiming());
+        window.attach(&game);
+        FrameProfiler profiler;
+        game.run(profiler, singleThread);
+
+        const InputLatencyTracker& latency = game.getLatency();
+        long long measured = latency.getSwapCallLatencies().count();
+        if (measured != latency.lastHandled()) allMeasured = false;
+        cout << name << ", " << hz << " Hz, swap " << swapMs << " ms: " << measured << " of " << presses
+             << " presses measured, " << presses - (int)latency.lastHandled() << " changed nothing, frame p50 "
+             << profiler.frameTimePercentile(0.5) << " ms" << endl;
+        printLatency(cout, "  to swap call: ", latency.getSwapCallLatencies());
+        printLatency(cout, "  to swap return: ", latency.getSwapReturnLatencies());
+
+        runs << (m ? ",\n" : "") << " {\"mode\": \"" << name << "\",\n  ";
+        writeLatencyReport(runs, latency);
+        runs << "}";
+    }
+
+    if (outPath) {
+        ofstream out(outPath);
+        out << "{\"presses\": " << presses << ", \"rate\": " << rate << ", \"hz\": " << hz << ", \"swap_ms\": "
+            << swapMs << ", \"seed\": " << seed << ",\n \"runs\": [\n" << runs.str() << "\n]}\n";
+        if (!out) {
+            cerr << "Failed to write " << outPath << endl;
+            return -1;
+        }
+    }
+    return allMeasured ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+#ifndef TETRIS_INPUT_H
+#define TETRIS_INPUT_H
+
+// Keyboard input between the window and the simulation. The window's key
+// callback pushes every press and release onto a KeyEventQueue, stamped
+// with the time it was delivered, and the game, on the simulation thread,
+// drains the queue one tick at a time: before each tick runs it takes the
+// events stamped at or before that tick's time. A press and release within
+// one frame both still reach the game, and when a frame runs several ticks
+// each key lands on the tick it belongs to rather than all on the first.
+//
+// AutoRepeat turns held keys into repeated inputs. A held left or right
+// shifts once on the press, again after the delayed auto-shift (DAS) and
+// then once every auto-repeat rate (ARR) ticks; a held soft drop repeats
+// every softDropTicks. Everything is counted in ticks, so the repeats are
+// ordinary inputs that record and replay like any other.
+
+#include "tetrisCore.h"
+#include "tetrisReplay.h"
+#include <atomic>
+#include <cstdint>
+
+struct KeyEvent {
+    double time;
+    int key;
+    bool pressed;
+};
+
+// Fixed-size ring of key events, filled by the window callback and drained
+// by the game. One thread may push while another pops: each index is only
+// written by its own side, and an event is published by the release store
+// of the write index after it has been copied in.
+class KeyEventQueue {
+public:
+    static const uint32_t CAPACITY = 256;
+
+private:
+    KeyEvent events[CAPACITY];
+    // Running counts of events pushed and popped; the ring slot is the count
+    // modulo CAPACITY.
+    std::atomic<uint32_t> written;
+    std::atomic<uint32_t> read;
+    long long dropped;
+
+public:
+    KeyEventQueue() : written(0), read(0), dropped(0) {}
+
+    // Returns false, and drops the event, when the queue is full.
+    bool push(const KeyEvent& event) {
+        uint32_t w = written.load(std::memory_order_relaxed);
+        if (w - read.load(std::memory_order_acquire) == CAPACITY) {
+            dropped++;
+            return false;
+        }
+        events[w % CAPACITY] = event;
+        written.store(w + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Takes the oldest event if it happened at or before time.
+    bool pop(double time, KeyEvent& event) {
+        uint32_t r = read.load(std::memory_order_relaxed);
+        if (r == written.load(std::memory_order_acquire) || events[r % CAPACITY].time > time) return false;
+        event = events[r % CAPACITY];
+        read.store(r + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(KeyEvent& event) {
+        uint32_t r = read.load(std::memory_order_relaxed);
+        if (r == written.load(std::memory_order_acquire)) return false;
+        return pop(events[r % CAPACITY].time, event);
+    }
+
+    // Events pushed and not yet popped.
+    int size() const {
+        return (int)(written.load(std::memory_order_acquire) - read.load(std::memory_order_acquire));
+    }
+
+    // Events push() turned away because the queue was full. Read on the
+    // pushing thread.
+    long long getDropped() const {
+        return dropped;
+    }
+};
+
+// Repeat timings in ticks. ARR and soft drop rate 0 move as far as the piece
+// can go each tick.
+struct InputTiming {
+    int dasTicks = 10;
+    int arrTicks = 2;
+    int softDropTicks = 2;
+
+    static int ticksFromMs(double ms) {
+        return ms <= 0.0 ? 0 : (int)(ms * TICKS_PER_SECOND / 1000.0 + 0.5);
+    }
+};
+
+class AutoRepeat {
+private:
+    InputTiming timing;
+    // Keys holding each input down; two keys can map to the same input.
+    uint8_t held[INPUT_COUNT];
+    // The shift direction being repeated, INPUT_COUNT for none. The last
+    // direction pressed wins while both are held.
+    GameInput shift;
+    int shiftTicks;
+    int dropTicks;
+
+    template <typename Core>
+    static bool canMove(const Core& core, GameInput input) {
+        int dx = input == INPUT_LEFT ? -1 : input == INPUT_RIGHT ? 1 : 0;
+        int dy = input == INPUT_SOFT_DROP ? 1 : 0;
+        return !core.checkCollision(core.getCurrentPiece(), dx, dy);
+    }
+
+    // Sends input every rate ticks of elapsed, or as often as it moves the
+    // piece when rate is 0. Moves that would be blocked are not sent, so
+    // holding a piece against a wall records nothing.
+    template <typename Core, typename Send>
+    static void repeat(const Core& core, GameInput input, int elapsed, int rate, Send& send) {
+        if (rate > 0) {
+            if (elapsed % rate == 0 && canMove(core, input)) send(input);
+            return;
+        }
+        for (int i = 0; i < Core::WIDTH + Core::HEIGHT && canMove(core, input); i++) {
+            send(input);
+        }
+    }
+
+public:
+    explicit AutoRepeat(const InputTiming& timing = InputTiming())
+        : timing(timing), held(), shift(INPUT_COUNT), shiftTicks(0), dropTicks(0) {
+        if (this->timing.dasTicks < 1) this->timing.dasTicks = 1;
+    }
+
+    const InputTiming& getTiming() const {
+        return timing;
+    }
+
+    // The press itself sends its input once; these only track the hold.
+    void press(GameInput input) {
+        if (input >= INPUT_COUNT) return;
+        held[input]++;
+        if (input == INPUT_LEFT || input == INPUT_RIGHT) {
+            shift = input;
+            shiftTicks = 0;
+        } else if (input == INPUT_SOFT_DROP) {
+            dropTicks = 0;
+        }
+    }
+
+    void release(GameInput input) {
+        if (input >= INPUT_COUNT || held[input] == 0) return;
+        if (--held[input] > 0 || input != shift) return;
+        // Falls back to the other direction if it is still held, charging
+        // its DAS from the start.
+        GameInput other = input == INPUT_LEFT ? INPUT_RIGHT : INPUT_LEFT;
+        shift = held[other] ? other : INPUT_COUNT;
+        shiftTicks = 0;
+    }
+
+    // Releases everything, for when the window loses track of the keys.
+    void clear() {
+        for (int i = 0; i < INPUT_COUNT; i++) held[i] = 0;
+        shift = INPUT_COUNT;
+    }
+
+    // Called once per tick, after that tick's key events. Calls
+    // send(GameInput) for every repeated input due.
+    template <typename Core, typename Send>
+    void update(const Core& core, Send send) {
+        if (shift != INPUT_COUNT) {
+            if (shiftTicks >= timing.dasTicks) {
+                repeat(core, shift, shiftTicks - timing.dasTicks, timing.arrTicks, send);
+            }
+            shiftTicks++;
+        }
+        if (held[INPUT_SOFT_DROP]) {
+            // The press itself was the drop at 0.
+            if (dropTicks > 0 || timing.softDropTicks == 0) {
+                repeat(core, INPUT_SOFT_DROP, dropTicks, timing.softDropTicks, send);
+            }
+            dropTicks++;
+        }
+    }
+};
+
+#endif
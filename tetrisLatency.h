@@ -0,0 +1,244 @@
+#ifndef TETRIS_LATENCY_H
+#define TETRIS_LATENCY_H
+
+// Input-to-present latency: how long after a key was pressed the first
+// frame showing its effect went to the display.
+//
+// The simulation numbers every key press whose input changed the game and
+// stamps it with the time on its KeyEvent, and each snapshot it publishes
+// carries the number of the last press handled before it was taken. When
+// the window hands a frame drawn from a snapshot to the buffer swap, every
+// press up to that number is on screen for the first time, and the time
+// since each was stamped is one sample. A second sample is taken when the
+// swap returns, which with vsync on includes the wait for the display.
+//
+// A real window only learns of a key when it polls for events, so its
+// stamps are the poll time and the samples leave out how long the key
+// waited to be polled. tetrisInject.cpp stamps its synthetic keys with the
+// time they were pressed, so its samples include that wait.
+
+#include "tetrisBatch.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Microsecond samples in fixed memory, so a window left running for days
+// measures every press without growing: the count, mean, min and max cover
+// every sample, and percentiles and histograms the last RECENT of them.
+class LatencySamples {
+public:
+    static const size_t RECENT = 4096;
+
+private:
+    long long recent[RECENT];
+    long long total;
+    double sum;
+    long long smallest;
+    long long largest;
+
+public:
+    LatencySamples() : total(0), sum(0.0), smallest(0), largest(0) {}
+
+    void add(long long sample) {
+        recent[(size_t)total % RECENT] = sample;
+        if (total == 0 || sample < smallest) smallest = sample;
+        if (total == 0 || sample > largest) largest = sample;
+        sum += (double)sample;
+        total++;
+    }
+
+    long long count() const {
+        return total;
+    }
+
+    double mean() const {
+        return total ? sum / total : 0.0;
+    }
+
+    long long min() const {
+        return smallest;
+    }
+
+    long long max() const {
+        return largest;
+    }
+
+    // Samples still held, at most RECENT.
+    size_t recentCount() const {
+        return (size_t)std::min<long long>(total, (long long)RECENT);
+    }
+
+    // Nearest-rank percentile, p in [0, 1], of the last Window samples held
+    // or all of them; 0 if there are none. Works on a copy on the stack, so
+    // the HUD can call it every frame without allocating.
+    template <size_t Window>
+    long long recentPercentile(double p) const {
+        static_assert(Window <= RECENT, "only RECENT samples are held");
+        size_t count = std::min(recentCount(), Window);
+        if (count == 0) return 0;
+        long long sorted[Window];
+        for (size_t i = 0; i < count; i++) {
+            sorted[i] = recent[(size_t)(total - (long long)count + (long long)i) % RECENT];
+        }
+        size_t rank = (size_t)(p * count + 0.999999);
+        size_t index = std::min(std::max<size_t>(rank, 1), count) - 1;
+        std::nth_element(sorted, sorted + index, sorted + count);
+        return sorted[index];
+    }
+
+    // Summary of the last count samples held, or all of them.
+    Distribution distribution(size_t count = 0) const {
+        if (count == 0 || count > recentCount()) count = recentCount();
+        std::vector<long long> values(count);
+        for (size_t i = 0; i < count; i++) {
+            values[i] = recent[(size_t)(total - (long long)count + (long long)i) % RECENT];
+        }
+        return Distribution::of(values);
+    }
+};
+
+class InputLatencyTracker {
+public:
+    static const uint32_t CAPACITY = 256;
+
+private:
+    struct Stamp {
+        uint32_t sequence;
+        double time;
+    };
+
+    // Presses handled and not yet presented, passed from the simulation to
+    // the window in a single-producer ring like KeyEventQueue.
+    Stamp stamps[CAPACITY];
+    std::atomic<uint32_t> written;
+    std::atomic<uint32_t> read;
+
+    // Simulation side.
+    uint32_t handled;
+    long long dropped;
+
+    // Window side: the stamps of the frame being swapped, and the samples
+    // in microseconds.
+    std::vector<double> swapping;
+    LatencySamples swapCallLatencies;
+    LatencySamples swapReturnLatencies;
+
+    static long long microseconds(double seconds) {
+        return (long long)(seconds * 1e6 + 0.5);
+    }
+
+public:
+    InputLatencyTracker() : written(0), read(0), handled(0), dropped(0) {}
+
+    // Simulation thread: a press stamped time has just changed the game.
+    void inputHandled(double time) {
+        handled++;
+        uint32_t w = written.load(std::memory_order_relaxed);
+        if (w - read.load(std::memory_order_acquire) == CAPACITY) {
+            // The window has stopped presenting; the press goes unmeasured.
+            dropped++;
+            return;
+        }
+        stamps[w % CAPACITY] = Stamp{handled, time};
+        written.store(w + 1, std::memory_order_release);
+    }
+
+    // Simulation thread: the number of the last press handled, for the
+    // next snapshot. Once the simulation has stopped, the count of them.
+    uint32_t lastHandled() const {
+        return handled;
+    }
+
+    // Window thread: a frame drawn from a snapshot taken after press
+    // number sequence is being handed to the swap at time.
+    void swapStarting(uint32_t sequence, double time) {
+        swapping.clear();
+        uint32_t r = read.load(std::memory_order_relaxed);
+        while (r != written.load(std::memory_order_acquire)) {
+            const Stamp& stamp = stamps[r % CAPACITY];
+            if ((int32_t)(stamp.sequence - sequence) > 0) break;
+            swapping.push_back(stamp.time);
+            swapCallLatencies.add(microseconds(time - stamp.time));
+            r++;
+        }
+        read.store(r, std::memory_order_release);
+    }
+
+    // Window thread: the swap started by swapStarting() has returned.
+    void swapFinished(double time) {
+        for (double stamp : swapping) {
+            swapReturnLatencies.add(microseconds(time - stamp));
+        }
+        swapping.clear();
+    }
+
+    // Microseconds from each press to the swap call that first showed it.
+    const LatencySamples& getSwapCallLatencies() const {
+        return swapCallLatencies;
+    }
+
+    // The same, to when that swap returned.
+    const LatencySamples& getSwapReturnLatencies() const {
+        return swapReturnLatencies;
+    }
+
+    // Presses that were handled but never measured because the ring was
+    // full. Read once the simulation thread has stopped.
+    long long getDropped() const {
+        return dropped;
+    }
+};
+
+// Statistics and histogram of microsecond samples, printed in milliseconds.
+inline void printLatency(std::ostream& out, const char* name, const LatencySamples& samples) {
+    Distribution d = samples.distribution();
+    out << std::fixed << std::setprecision(2) << name << samples.count() << " presses, mean "
+        << samples.mean() / 1000.0 << " ms, min " << samples.min() / 1000.0 << ", p50 " << d.p50 / 1000.0
+        << ", p90 " << d.p90 / 1000.0 << ", p99 " << d.p99 / 1000.0 << ", max " << samples.max() / 1000.0;
+    if (d.count < samples.count()) out << " (percentiles of the last " << d.count << ")";
+    out << std::endl;
+    if (d.count == 0) return;
+
+    long long largest = 1;
+    for (long long bucket : d.buckets) {
+        largest = std::max(largest, bucket);
+    }
+    for (int i = 0; i < Distribution::HISTOGRAM_BUCKETS; i++) {
+        long long low = d.min + i * d.bucketWidth;
+        if (low > d.max) break;
+        out << "  " << std::setw(7) << low / 1000.0 << "-" << std::setw(7) << (low + d.bucketWidth) / 1000.0
+            << " ms\t" << d.buckets[i] << "\t" << std::string((size_t)(40 * d.buckets[i] / largest), '#')
+            << std::endl;
+    }
+}
+
+// The same as a JSON object, in milliseconds. recent_count is how many of
+// the last samples the percentiles and buckets cover, which start at
+// bucket_start_ms.
+inline void writeLatencyJson(std::ostream& out, const LatencySamples& samples) {
+    Distribution d = samples.distribution();
+    out << std::fixed << std::setprecision(3) << "{\"count\": " << samples.count()
+        << ", \"mean_ms\": " << samples.mean() / 1000.0 << ", \"min_ms\": " << samples.min() / 1000.0
+        << ", \"max_ms\": " << samples.max() / 1000.0 << ", \"recent_count\": " << d.count
+        << ", \"p50_ms\": " << d.p50 / 1000.0 << ", \"p90_ms\": " << d.p90 / 1000.0
+        << ", \"p99_ms\": " << d.p99 / 1000.0 << ", \"bucket_start_ms\": " << d.min / 1000.0
+        << ", \"bucket_ms\": " << d.bucketWidth / 1000.0 << ", \"buckets\": [";
+    for (int i = 0; i < Distribution::HISTOGRAM_BUCKETS; i++) {
+        out << (i ? ", " : "") << d.buckets[i];
+    }
+    out << "]}";
+}
+
+// Both measurements of a tracker, as the body of a JSON object.
+inline void writeLatencyReport(std::ostream& out, const InputLatencyTracker& latency) {
+    out << "\"dropped\": " << latency.getDropped() << ",\n  \"to_swap_call\": ";
+    writeLatencyJson(out, latency.getSwapCallLatencies());
+    out << ",\n  \"to_swap_return\": ";
+    writeLatencyJson(out, latency.getSwapReturnLatencies());
+}
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef TETRIS_PIECES_H
+#define TETRIS_PIECES_H
+
+// Per-piece, per-rotation data generated at compile time from
+// TETROMINO_SHAPES. Rotation r is the spawn shape turned clockwise r times
+// inside its 4x4 box, which is exactly what the old runtime transpose did.
+
+#include <cstdint>
+
+constexpr int TETROMINO_SHAPES[7][4][4] = {
+    {{0,0,0,0}, {1,1,1,1}, {0,0,0,0}, {0,0,0,0}},
+    {{0,0,0,0}, {0,1,1,0}, {0,1,1,0}, {0,0,0,0}},
+    {{0,0,0,0}, {0,1,0,0}, {1,1,1,0}, {0,0,0,0}},
+    {{0,0,0,0}, {0,1,1,0}, {1,1,0,0}, {0,0,0,0}},
+    {{0,0,0,0}, {1,1,0,0}, {0,1,1,0}, {0,0,0,0}},
+    {{0,0,0,0}, {1,0,0,0}, {1,1,1,0}, {0,0,0,0}},
+    {{0,0,0,0}, {0,0,1,0}, {1,1,1,0}, {0,0,0,0}}
+};
+
+const float TETROMINO_COLORS[7][3] = {
+    {0.0f, 1.0f, 1.0f},
+    {1.0f, 1.0f, 0.0f},
+    {0.5f, 0.0f, 0.5f},
+    {0.0f, 1.0f, 0.0f},
+    {1.0f, 0.0f, 0.0f},
+    {0.0f, 0.0f, 1.0f},
+    {1.0f, 0.5f, 0.0f}
+};
+
+const int PIECE_TYPES = 7;
+const int PIECE_ROTATIONS = 4;
+
+// Offsets tried in order when rotating; the first one that fits wins.
+const int KICK_COUNT = 6;
+constexpr int8_t KICK_OFFSETS[KICK_COUNT][2] = {
+    {0, 0}, {-1, 0}, {1, 0}, {0, -1}, {-1, -1}, {1, -1}
+};
+
+struct CellOffset {
+    int8_t x, y;
+};
+
+struct PieceRotation {
+    CellOffset cells[4];
+    uint8_t rows[4];
+    // Lowest cell in each column of the 4x4 box, -1 for an empty column.
+    int8_t bottoms[4];
+    int8_t minX, minY, maxX, maxY;
+};
+
+struct PieceInfo {
+    PieceRotation rotations[PIECE_ROTATIONS];
+    // spawnX is counted from the middle column of the board.
+    int8_t spawnX, spawnY;
+    CellOffset kicks[PIECE_ROTATIONS][KICK_COUNT];
+};
+
+struct PieceTable {
+    PieceInfo pieces[PIECE_TYPES];
+
+    constexpr PieceTable() : pieces() {
+        for (int type = 0; type < PIECE_TYPES; type++) {
+            int shape[4][4] = {};
+            for (int y = 0; y < 4; y++) {
+                for (int x = 0; x < 4; x++) {
+                    shape[y][x] = TETROMINO_SHAPES[type][y][x];
+                }
+            }
+
+            PieceInfo& info = pieces[type];
+            for (int rot = 0; rot < PIECE_ROTATIONS; rot++) {
+                PieceRotation& r = info.rotations[rot];
+                r.minX = r.minY = 3;
+                r.maxX = r.maxY = 0;
+                for (int x = 0; x < 4; x++) {
+                    r.bottoms[x] = -1;
+                }
+
+                int cell = 0;
+                for (int y = 0; y < 4; y++) {
+                    r.rows[y] = 0;
+                    for (int x = 0; x < 4; x++) {
+                        if (!shape[y][x]) continue;
+                        r.cells[cell].x = (int8_t)x;
+                        r.cells[cell].y = (int8_t)y;
+                        cell++;
+                        r.rows[y] = (uint8_t)(r.rows[y] | (1 << x));
+                        r.bottoms[x] = (int8_t)y;
+                        if (x < r.minX) r.minX = (int8_t)x;
+                        if (x > r.maxX) r.maxX = (int8_t)x;
+                        if (y < r.minY) r.minY = (int8_t)y;
+                        if (y > r.maxY) r.maxY = (int8_t)y;
+                    }
+                }
+
+                for (int k = 0; k < KICK_COUNT; k++) {
+                    info.kicks[rot][k].x = KICK_OFFSETS[k][0];
+                    info.kicks[rot][k].y = KICK_OFFSETS[k][1];
+                }
+
+                int rotated[4][4] = {};
+                for (int y = 0; y < 4; y++) {
+                    for (int x = 0; x < 4; x++) {
+                        rotated[x][3-y] = shape[y][x];
+                    }
+                }
+                for (int y = 0; y < 4; y++) {
+                    for (int x = 0; x < 4; x++) {
+                        shape[y][x] = rotated[y][x];
+                    }
+                }
+            }
+
+            info.spawnX = -2;
+            info.spawnY = 0;
+        }
+    }
+};
+
+constexpr PieceTable PIECE_TABLE;
+
+inline constexpr const PieceRotation& pieceRotation(int type, int rotation) {
+    return PIECE_TABLE.pieces[type].rotations[rotation];
+}
+
+// A piece is only its type, rotation and position; everything else comes
+// from PIECE_TABLE.
+struct Tetromino {
+    int8_t type;
+    int8_t rotation;
+    int8_t x, y;
+
+    Tetromino() : type(0), rotation(0), x(0), y(0) {}
+
+    void setType(int newType) {
+        type = (int8_t)newType;
+        rotation = 0;
+    }
+
+    const PieceRotation& shape() const {
+        return pieceRotation(type, rotation);
+    }
+
+    const float* color() const {
+        return TETROMINO_COLORS[type];
+    }
+
+    bool operator==(const Tetromino& other) const {
+        return type == other.type && rotation == other.rotation && x == other.x && y == other.y;
+    }
+
+    bool operator!=(const Tetromino& other) const {
+        return !(*this == other);
+    }
+};
+
+static_assert(sizeof(Tetromino) == 4, "Tetromino should stay four bytes");
+
+#endif
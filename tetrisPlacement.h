@@ -0,0 +1,588 @@
+#ifndef TETRIS_PLACEMENT_H
+#define TETRIS_PLACEMENT_H
+
+// Enumerates every distinct lock position a piece can reach from where it
+// starts, using the same moves the player has: shift left or right, soft
+// drop, hard drop and rotatePiece() with its kick list. Gravity is ignored,
+// as if every input arrives before the next fall step.
+//
+// States are kept as one bit per row for every (rotation, column), so whole
+// columns of states move at once: a shift is an AND with the next column, a
+// hard drop is a carry through a run of free rows, and a rotation tries the
+// kicks in order on every row of a column together.
+//
+// find() is a breadth-first search done that way, a whole depth at a time,
+// so each placement is found after the fewest inputs. Soft drops are not
+// expanded one row per input: a piece falls through a column on its own,
+// and a column is only expanded again where something else moves into it
+// or the falling piece gets to a row it can shift or rotate from to a new
+// state. find() keeps the rows it expanded at every depth, and inputs()
+// walks one placement back through them to write out its moves, so
+// sequences are only built for the placements that are played. findLocks()
+// finds the same placements without input counts, for callers that only
+// need where a piece can end up, by flooding until nothing changes. All
+// storage lives in the PlacementFinder and is reused between calls; nothing
+// is allocated per search once it has seen its deepest one.
+
+#include "tetrisCore.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+enum PlacementMove : uint8_t {
+    MOVE_LEFT,
+    MOVE_RIGHT,
+    MOVE_ROTATE,
+    MOVE_SOFT_DROP,
+    MOVE_HARD_DROP,
+    MOVE_COUNT
+};
+
+const char* const PLACEMENT_MOVE_NAMES[MOVE_COUNT] = {"left", "right", "rotate", "soft drop", "hard drop"};
+
+// Replays one move on the core the way the matching key would.
+inline void applyPlacementMove(TetrisCore& core, PlacementMove move) {
+    switch (move) {
+        case MOVE_LEFT: core.movePiece(-1, 0); break;
+        case MOVE_RIGHT: core.movePiece(1, 0); break;
+        case MOVE_ROTATE: core.rotatePiece(); break;
+        case MOVE_SOFT_DROP: core.movePiece(0, 1); break;
+        case MOVE_HARD_DROP: core.hardDrop(); break;
+        default: break;
+    }
+}
+
+// Rotations whose cells are the same shape lock to the same cells. Each
+// rotation maps to the lowest-numbered rotation with an identical shape
+// (O has one shape, I, S and Z have two, the rest four).
+struct ShapeClassTable {
+    int8_t canonical[PIECE_TYPES][PIECE_ROTATIONS];
+
+    constexpr ShapeClassTable() : canonical() {
+        for (int type = 0; type < PIECE_TYPES; type++) {
+            for (int rot = 0; rot < PIECE_ROTATIONS; rot++) {
+                canonical[type][rot] = (int8_t)rot;
+                for (int other = 0; other < rot; other++) {
+                    if (sameShape(PIECE_TABLE.pieces[type].rotations[rot], PIECE_TABLE.pieces[type].rotations[other])) {
+                        canonical[type][rot] = canonical[type][other];
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    static constexpr bool sameShape(const PieceRotation& a, const PieceRotation& b) {
+        for (int y = 0; y < 4; y++) {
+            int rowA = a.minY + y < 4 ? a.rows[a.minY + y] >> a.minX : 0;
+            int rowB = b.minY + y < 4 ? b.rows[b.minY + y] >> b.minX : 0;
+            if (rowA != rowB) return false;
+        }
+        return true;
+    }
+};
+
+constexpr ShapeClassTable SHAPE_CLASSES;
+
+// Whether two resting pieces cover the same cells.
+inline bool sameLock(const Tetromino& a, const Tetromino& b) {
+    const PieceRotation& shapeA = a.shape();
+    const PieceRotation& shapeB = b.shape();
+    return a.type == b.type && SHAPE_CLASSES.canonical[a.type][a.rotation] == SHAPE_CLASSES.canonical[b.type][b.rotation] &&
+           a.x + shapeA.minX == b.x + shapeB.minX && a.y + shapeA.minY == b.y + shapeB.minY;
+}
+
+struct Placement {
+    // Where the piece locks.
+    Tetromino piece;
+    // Length of the shortest input sequence that gets it there;
+    // PlacementFinder::inputs writes out the moves themselves.
+    uint16_t inputCount;
+    // The resting state, as a PlacementFinder node index.
+    uint16_t node;
+};
+
+class PlacementFinder {
+public:
+    // Piece origins the search can represent: every column a piece can reach
+    // and every row from BOARD_TOP above the field down to its bottom.
+    static const int STATE_COLUMNS = GRID_WIDTH + BOARD_WALL;
+    static const int STATE_ROWS = BOARD_TOP + GRID_HEIGHT;
+    static const uint32_t STATE_ROW_MASK = (1u << STATE_ROWS) - 1;
+
+    // Node index is rotation << 10 | row << 5 | column + 1, row and column
+    // counted from the top-left of the state space.
+    static const int STATE_COUNT = PIECE_ROTATIONS << 10;
+
+private:
+    // Bit col of cols[rot] is set for the columns find() expands at one
+    // depth: ones something moved into, or where a falling piece gets to a
+    // turn row.
+    struct DepthColumns {
+        uint32_t cols[PIECE_ROTATIONS];
+    };
+
+    // The rows of one column that find() expanded at one depth.
+    struct Expansion {
+        uint8_t rot;
+        uint8_t col;
+        uint32_t rows;
+    };
+
+    // Bit row of free[rot][col + 1] is set if the piece fits there, so a
+    // collision test is one bit test. Kicks and shifts move at most one
+    // column, and the zero column on either side stands in for the bounds
+    // check.
+    uint32_t free[PIECE_ROTATIONS][STATE_COLUMNS + 2];
+    uint32_t visited[PIECE_ROTATIONS][STATE_COLUMNS + 2];
+    uint32_t lockSeen[PIECE_ROTATIONS][GRID_WIDTH];
+    // find() lets pieces soft drop a column at a time, only when something
+    // else reaches the column: falling[rot][col] holds the rows they have
+    // fallen to after fallDepth[rot][col] inputs.
+    uint32_t falling[PIECE_ROTATIONS][STATE_COLUMNS + 2];
+    int fallDepth[PIECE_ROTATIONS][STATE_COLUMNS + 2];
+    // The rows of (rot, col) where a piece may shift or rotate to a state
+    // it could not reach from the row above; see buildTurnRows().
+    uint32_t turnRows[PIECE_ROTATIONS][STATE_COLUMNS + 2];
+    // find()'s columns to expand at each depth, and the rows moved into at
+    // the current depth and the next one.
+    std::vector<DepthColumns> depths;
+    int depthCount;
+    uint32_t frontier[2][PIECE_ROTATIONS][STATE_COLUMNS + 2];
+    // What find() expanded, depth by depth, with the first entry of each
+    // depth in depthStarts, and the board and piece it searched, for
+    // inputs().
+    std::vector<Expansion> expanded;
+    std::vector<int> depthStarts;
+    Bitboard searchBoard;
+    int searchType;
+
+    Placement results[STATE_COUNT];
+    int resultCount;
+
+    static int nodeIndex(int rot, int row, int col) {
+        return (rot << 10) | (row << 5) | col;
+    }
+
+    bool fits(int rot, int row, int col) const {
+        return (free[rot][col] >> row) & 1;
+    }
+
+    // Fills free[][] for a piece of the given type on board.
+    void buildFreeMasks(const Bitboard& board, const PieceInfo& info) {
+        uint32_t columns[BOARD_COLUMNS];
+        board.getColumns(columns);
+        for (int rot = 0; rot < PIECE_ROTATIONS; rot++) {
+            const CellOffset* cells = info.rotations[rot].cells;
+            free[rot][0] = free[rot][STATE_COLUMNS + 1] = 0;
+            for (int col = 0; col < STATE_COLUMNS; col++) {
+                uint32_t blocked = (columns[col + cells[0].x] >> cells[0].y) |
+                                   (columns[col + cells[1].x] >> cells[1].y) |
+                                   (columns[col + cells[2].x] >> cells[2].y) |
+                                   (columns[col + cells[3].x] >> cells[3].y);
+                free[rot][col + 1] = ~blocked & STATE_ROW_MASK;
+            }
+        }
+        memset(lockSeen, 0, sizeof(lockSeen));
+    }
+
+    // Whether rotating never moves the piece, as for O: every rotation
+    // covers the same cells and the first kick stays put, so it always
+    // fits. A search leaves such rotations out; they only cost an input.
+    static bool turnsInPlace(const PieceInfo& info) {
+        for (int rot = 0; rot < PIECE_ROTATIONS; rot++) {
+            if (memcmp(info.rotations[rot].rows, info.rotations[(rot + 1) & 3].rows, 4) != 0) return false;
+            if (info.kicks[rot][0].x != 0 || info.kicks[rot][0].y != 0) return false;
+        }
+        return true;
+    }
+
+    // Records a piece resting at each of rows of (rot, col) unless a
+    // placement with the same cells has been recorded.
+    void addLocks(int type, int rot, int col, uint32_t rows, int depth) {
+        const PieceRotation& shape = PIECE_TABLE.pieces[type].rotations[rot];
+        uint32_t& seen = lockSeen[SHAPE_CLASSES.canonical[type][rot]][col - BOARD_WALL - 1 + shape.minX];
+        rows &= ~(seen >> shape.minY);
+        seen |= rows << shape.minY;
+        for (; rows; rows &= rows - 1) {
+            int row = lowestSetBit(rows);
+            Placement& p = results[resultCount++];
+            p.piece.type = (int8_t)type;
+            p.piece.rotation = (int8_t)rot;
+            p.piece.x = (int8_t)(col - BOARD_WALL - 1);
+            p.piece.y = (int8_t)(row - BOARD_TOP);
+            p.inputCount = (uint16_t)depth;
+            p.node = (uint16_t)nodeIndex(rot, row, col);
+        }
+    }
+
+    // Adds to every free row of a column the free rows below it in the
+    // same run. Adding the rows to the column's free mask carries through
+    // each run from its first reached row to its end.
+    static uint32_t dropFill(uint32_t rows, uint32_t freeRows) {
+        return rows | (((freeRows + rows) ^ freeRows) & freeRows);
+    }
+
+    // The rows of nextFree that a kick of kickY rows lands on, indexed by
+    // the row it starts from. Rows above the state space hold only the
+    // walls, like row 0, so a kick out of it fits where row 0 does; it
+    // takes the piece out of the search, since the game would have.
+    static uint32_t kickFits(uint32_t nextFree, int kickY) {
+        if (kickY > 0) return nextFree >> kickY;
+        return ((nextFree << -kickY) | ((nextFree & 1) * ((1u << -kickY) - 1))) & STATE_ROW_MASK;
+    }
+
+    // Every piece kicks with KICK_OFFSETS, so rotateRows() can take them
+    // from there as constants.
+    static constexpr bool kicksShared() {
+        for (int type = 0; type < PIECE_TYPES; type++) {
+            for (int rot = 0; rot < PIECE_ROTATIONS; rot++) {
+                for (int i = 0; i < KICK_COUNT; i++) {
+                    const CellOffset& kick = PIECE_TABLE.pieces[type].kicks[rot][i];
+                    if (kick.x != KICK_OFFSETS[i][0] || kick.y != KICK_OFFSETS[i][1]) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Rotates rows of (rot, col) to the next rotation, each with the first
+    // kick that fits as in TetrisCore::rotatePiece, and passes
+    // reach(column, rows landed on) for each kick used. Kick
+    // is the first kick to try; each one is its own instantiation, so its
+    // offsets are constants.
+    template <int Kick = 0, typename Reach>
+    void rotateRows(int rot, int col, uint32_t pending, const Reach& reach) {
+        static_assert(kicksShared(), "rotateRows() kicks with KICK_OFFSETS");
+        if constexpr (Kick < KICK_COUNT) {
+            if (!pending) return;
+            const int kickX = KICK_OFFSETS[Kick][0];
+            const int kickY = KICK_OFFSETS[Kick][1];
+            uint32_t fitting = kickFits(free[(rot + 1) & 3][col + kickX], kickY);
+            uint32_t rotated = pending & fitting;
+            if (rotated) reach(col + kickX, kickY <= 0 ? rotated >> -kickY : rotated << kickY);
+            rotateRows<Kick + 1>(rot, col, pending & ~fitting, reach);
+        }
+    }
+
+    // A piece that soft drops onto a row can shift or rotate from it to
+    // where the same move one row higher and a soft drop would take it, in
+    // as many inputs, unless the row is the top of a run it shifts into or
+    // the kick that fits changes there. Kicks move at most a column across
+    // and a row up, so that is only at the edge of a run of the next
+    // rotation in the column or either side of it, or the row below one.
+    // Fills turnRows[][] with those rows, the only ones find() has to
+    // expand for a falling piece, and a few more.
+    void buildTurnRows() {
+        for (int rot = 0; rot < PIECE_ROTATIONS; rot++) {
+            const uint32_t* freeRows = free[rot];
+            const uint32_t* nextFree = free[(rot + 1) & 3];
+            uint32_t edges[STATE_COLUMNS + 2];
+            for (int col = 0; col < STATE_COLUMNS + 2; col++) edges[col] = nextFree[col] ^ (nextFree[col] << 1);
+            for (int col = 1; col <= STATE_COLUMNS; col++) {
+                uint32_t left = freeRows[col - 1];
+                uint32_t right = freeRows[col + 1];
+                uint32_t kicked = edges[col - 1] | edges[col] | edges[col + 1];
+                turnRows[rot][col] = (left & ~(left << 1)) | (right & ~(right << 1)) | kicked | (kicked << 1);
+            }
+        }
+    }
+
+    // Lets the pieces falling in (rot, col) soft drop until depth inputs.
+    // Each stops at a row reached earlier, since whatever reached it falls
+    // on from there.
+    void fall(int rot, int col, int depth) {
+        uint32_t rows = falling[rot][col];
+        int at = fallDepth[rot][col];
+        fallDepth[rot][col] = depth;
+        if (!rows) return;
+        const uint32_t freeRows = free[rot][col];
+        uint32_t seen = visited[rot][col];
+        for (; at < depth && rows; at++) {
+            rows = (rows << 1) & freeRows & ~seen;
+            seen |= rows;
+        }
+        falling[rot][col] = rows;
+        visited[rot][col] = seen;
+    }
+
+    DepthColumns& depthColumns(int depth) {
+        if ((int)depths.size() <= depth) depths.resize(depth + 1);
+        for (; depthCount <= depth; depthCount++) memset(&depths[depthCount], 0, sizeof(DepthColumns));
+        return depths[depth];
+    }
+
+    // Makes find() expand (rot, col) at the depth a piece starting to fall
+    // from rows after depth inputs gets to each turn row below them. It
+    // stops at a row reached earlier, and the bottom of the run, which the
+    // hard drop gets to first.
+    void bookTurns(int rot, int col, uint32_t rows, int depth) {
+        const uint32_t freeRows = free[rot][col];
+        for (uint32_t turns = dropFill(rows, freeRows & ~(visited[rot][col] & ~rows)) & ~rows & (freeRows >> 1) &
+                              turnRows[rot][col];
+             turns; turns &= turns - 1) {
+            int row = lowestSetBit(turns);
+            // The nearest row above in the run gets there first.
+            depthColumns(depth + row - highestSetBit(rows & ((1u << row) - 1))).cols[rot] |= 1u << col;
+        }
+    }
+
+    // The rows of (rot, col) the last find() expanded after depth inputs.
+    uint32_t expandedRows(int depth, int rot, int col) const {
+        if (depth + 1 >= (int)depthStarts.size()) return 0;
+        for (int i = depthStarts[depth]; i < depthStarts[depth + 1]; i++) {
+            if (expanded[i].rot == rot && expanded[i].col == col) return expanded[i].rows;
+        }
+        return 0;
+    }
+
+    // The kick a piece at (rot, row, col) rotates with, or -1 if it cannot
+    // rotate, on the board of the last find().
+    int rotationKick(const PieceInfo& info, int rot, int row, int col) const {
+        const int nextRot = (rot + 1) & 3;
+        for (int i = 0; i < KICK_COUNT; i++) {
+            const CellOffset& kick = info.kicks[rot][i];
+            int kickRow = row + kick.y;
+            if (kickRow < 0) {
+                if (!searchBoard.collides(info.rotations[nextRot].rows, col + kick.x - BOARD_WALL - 1, kickRow - BOARD_TOP)) {
+                    return -1;
+                }
+                continue;
+            }
+            if (kickRow < STATE_ROWS && fits(nextRot, kickRow, col + kick.x)) return i;
+        }
+        return -1;
+    }
+
+public:
+    PlacementFinder() : depthCount(0), searchType(0), resultCount(0) {}
+
+    // Finds every placement reachable from start on board and returns how
+    // many there are. Returns 0 if start itself collides.
+    int find(const Bitboard& board, const Tetromino& start) {
+        const int type = start.type;
+        const PieceInfo& info = PIECE_TABLE.pieces[type];
+        resultCount = 0;
+
+        int startRow = start.y + BOARD_TOP;
+        int startCol = start.x + BOARD_WALL + 1;
+        if (startRow < 0 || startRow >= STATE_ROWS || startCol < 1 || startCol > STATE_COLUMNS) return 0;
+
+        buildFreeMasks(board, info);
+        if (!fits(start.rotation, startRow, startCol)) return 0;
+        buildTurnRows();
+        searchBoard = board;
+        searchType = type;
+        const bool rotates = !turnsInPlace(info);
+
+        // frontier holds every state one move from the depth before, and
+        // find() expands the ones not reached yet. Soft drops are left to
+        // fall(), so only rows reached some other way are expanded, and the
+        // turn rows falling pieces get to.
+        memset(visited, 0, sizeof(visited));
+        memset(falling, 0, sizeof(falling));
+        memset(fallDepth, 0, sizeof(fallDepth));
+        memset(frontier, 0, sizeof(frontier));
+        expanded.clear();
+        depthStarts.clear();
+        depthCount = 0;
+        frontier[0][start.rotation][startCol] = 1u << startRow;
+        depthColumns(0).cols[start.rotation] = 1u << startCol;
+
+        for (int depth = 0; depth < depthCount; depth++) {
+            depthStarts.push_back((int)expanded.size());
+            const uint32_t* active = depths[depth].cols;
+            if (!(active[0] | active[1] | active[2] | active[3])) continue;
+            depthColumns(depth + 1);
+            uint32_t (*moved)[STATE_COLUMNS + 2] = frontier[depth & 1];
+            uint32_t (*next)[STATE_COLUMNS + 2] = frontier[(depth + 1) & 1];
+            for (int rot = 0; rot < PIECE_ROTATIONS; rot++) {
+                const int nextRot = (rot + 1) & 3;
+                const uint32_t* freeRows = free[rot];
+                uint32_t shifted = 0;
+                uint32_t turned = 0;
+                for (uint32_t cols = depths[depth].cols[rot]; cols; cols &= cols - 1) {
+                    const int col = lowestSetBit(cols);
+                    fall(rot, col, depth);
+                    // A state rests when the row below it is not free, and a
+                    // piece that has just fallen there rests too.
+                    const uint32_t bottoms = ~(freeRows[col] >> 1);
+                    const uint32_t entered = moved[rot][col] & ~visited[rot][col];
+                    const uint32_t rows = entered | (((moved[rot][col] & bottoms) | turnRows[rot][col]) & falling[rot][col]);
+                    moved[rot][col] = 0;
+                    if (!rows) continue;
+                    expanded.push_back({(uint8_t)rot, (uint8_t)col, rows});
+                    visited[rot][col] |= entered;
+                    falling[rot][col] |= entered;
+                    if (entered) bookTurns(rot, col, entered, depth);
+
+                    if (rows & bottoms) addLocks(type, rot, col, rows & bottoms, depth);
+                    // Rows already reached stay out; ones falling pieces
+                    // reach by then are dropped when the column is expanded.
+                    const uint32_t* seen = visited[rot];
+                    uint32_t left = rows & freeRows[col - 1] & ~seen[col - 1];
+                    uint32_t right = rows & freeRows[col + 1] & ~seen[col + 1];
+                    // A hard drop lands at the bottom of the run.
+                    uint32_t down = dropFill(rows, freeRows[col]) & bottoms & ~seen[col];
+                    next[rot][col - 1] |= left;
+                    next[rot][col + 1] |= right;
+                    next[rot][col] |= down;
+                    shifted |= (uint32_t)(left != 0) << (col - 1) | (uint32_t)(right != 0) << (col + 1) |
+                               (uint32_t)(down != 0) << col;
+                    if (!rotates) continue;
+                    const uint32_t* nextSeen = visited[nextRot];
+                    rotateRows(rot, col, rows, [&](int toCol, uint32_t target) {
+                        target &= ~nextSeen[toCol];
+                        next[nextRot][toCol] |= target;
+                        turned |= (uint32_t)(target != 0) << toCol;
+                    });
+                }
+                // Booking turns can move depths, so it is looked up here.
+                depths[depth + 1].cols[rot] |= shifted;
+                depths[depth + 1].cols[nextRot] |= turned;
+            }
+        }
+        depthStarts.push_back((int)expanded.size());
+
+        return resultCount;
+    }
+
+    // Searches from the core's current piece.
+    int find(const TetrisCore& core) {
+        return find(core.getBoard(), core.getCurrentPiece());
+    }
+
+    // Finds the same placements as find(), possibly in another order and
+    // with other rotations standing for ones of the same shape, but without
+    // input sequences: inputCount is 0 and inputs() must not be called.
+    int findLocks(const Bitboard& board, const Tetromino& start) {
+        const int type = start.type;
+        const PieceInfo& info = PIECE_TABLE.pieces[type];
+        resultCount = 0;
+
+        int startRow = start.y + BOARD_TOP;
+        int startCol = start.x + BOARD_WALL + 1;
+        if (startRow < 0 || startRow >= STATE_ROWS || startCol < 1 || startCol > STATE_COLUMNS) return 0;
+
+        buildFreeMasks(board, info);
+        if (!fits(start.rotation, startRow, startCol)) return 0;
+
+        // visited[rot][col] holds the reached rows, spreading until a pass
+        // over every rotation adds none.
+        memset(visited, 0, sizeof(visited));
+        visited[start.rotation][startCol] = dropFill(1u << startRow, free[start.rotation][startCol]);
+        const bool rotates = !turnsInPlace(info);
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int rot = 0; rot < PIECE_ROTATIONS; rot++) {
+                uint32_t* reach = visited[rot];
+                const uint32_t* freeRows = free[rot];
+                for (int col = 2; col <= STATE_COLUMNS; col++) {
+                    uint32_t rows = dropFill(reach[col] | (reach[col - 1] & freeRows[col]), freeRows[col]);
+                    changed |= rows != reach[col];
+                    reach[col] = rows;
+                }
+                for (int col = STATE_COLUMNS - 1; col >= 1; col--) {
+                    uint32_t rows = dropFill(reach[col] | (reach[col + 1] & freeRows[col]), freeRows[col]);
+                    changed |= rows != reach[col];
+                    reach[col] = rows;
+                }
+
+                if (!rotates) continue;
+                uint32_t* nextReach = visited[(rot + 1) & 3];
+                const uint32_t* nextFree = free[(rot + 1) & 3];
+                for (int col = 1; col <= STATE_COLUMNS; col++) {
+                    rotateRows(rot, col, reach[col], [&](int toCol, uint32_t target) {
+                        uint32_t rows = dropFill(nextReach[toCol] | target, nextFree[toCol]);
+                        if (rows != nextReach[toCol]) {
+                            nextReach[toCol] = rows;
+                            changed = true;
+                        }
+                    });
+                }
+            }
+        }
+
+        // A reached state rests when the row below it is not free.
+        for (int rot = 0; rot < PIECE_ROTATIONS; rot++) {
+            for (int col = 1; col <= STATE_COLUMNS; col++) {
+                uint32_t resting = visited[rot][col] & ~(free[rot][col] >> 1);
+                if (resting) addLocks(type, rot, col, resting, 0);
+            }
+        }
+        return resultCount;
+    }
+
+    int getCount() const {
+        return resultCount;
+    }
+
+    const Placement& get(int i) const {
+        return results[i];
+    }
+
+    const Placement* begin() const {
+        return results;
+    }
+
+    const Placement* end() const {
+        return results + resultCount;
+    }
+
+    // Writes the shortest input sequence for a placement from the last
+    // find() into out, which must hold placement.inputCount moves. Walks
+    // back from the resting state, each step to a state expanded one input
+    // earlier that the move leads from, or else the row above, which a
+    // falling piece passed one input earlier.
+    void inputs(const Placement& placement, PlacementMove* out) const {
+        const PieceInfo& info = PIECE_TABLE.pieces[searchType];
+        int rot = placement.node >> 10;
+        int row = (placement.node >> 5) & 31;
+        int col = placement.node & 31;
+        for (int depth = placement.inputCount; depth > 0; depth--) {
+            auto reached = [&](int fromRot, int fromRow, int fromCol) {
+                return fromRow >= 0 && fromRow < STATE_ROWS && (expandedRows(depth - 1, fromRot, fromCol) >> fromRow & 1);
+            };
+            PlacementMove move = MOVE_COUNT;
+            if (reached(rot, row, col + 1)) {
+                move = MOVE_LEFT;
+                col++;
+            } else if (reached(rot, row, col - 1)) {
+                move = MOVE_RIGHT;
+                col--;
+            } else if (!(free[rot][col] >> (row + 1) & 1)) {
+                // A hard drop lands here from anywhere higher in the run.
+                for (int from = row - 1; from >= 0 && (free[rot][col] >> from & 1); from--) {
+                    if (from < row - 1 && reached(rot, from, col)) {
+                        move = MOVE_HARD_DROP;
+                        row = from;
+                        break;
+                    }
+                }
+            }
+            if (move == MOVE_COUNT) {
+                const int fromRot = (rot + 3) & 3;
+                for (int i = 0; i < KICK_COUNT; i++) {
+                    const CellOffset& kick = info.kicks[fromRot][i];
+                    int fromRow = row - kick.y;
+                    int fromCol = col - kick.x;
+                    if (reached(fromRot, fromRow, fromCol) && rotationKick(info, fromRot, fromRow, fromCol) == i) {
+                        move = MOVE_ROTATE;
+                        rot = fromRot;
+                        row = fromRow;
+                        col = fromCol;
+                        break;
+                    }
+                }
+            }
+            if (move == MOVE_COUNT) {
+                move = MOVE_SOFT_DROP;
+                row--;
+            }
+            out[depth - 1] = move;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef TETRIS_PROFILE_H
+#define TETRIS_PROFILE_H
+
+// Per-frame CPU timing for the main loop. Each frame is split into phases;
+// the profiler keeps a rolling window of frame times for percentiles and
+// averages the phase times and per-frame counters over the same window.
+
+#include <algorithm>
+#include <chrono>
+
+enum FramePhase {
+    PHASE_INPUT,
+    PHASE_SIMULATION,
+    PHASE_RENDER,
+    PHASE_SWAP,
+    PHASE_COUNT
+};
+
+const char* const FRAME_PHASE_NAMES[PHASE_COUNT] = {"INPUT", "SIM", "RENDER", "SWAP"};
+
+class FrameProfiler {
+public:
+    static const int WINDOW = 240;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point frameStart;
+    Clock::time_point phaseStart;
+    bool started;
+
+    double frameTimes[WINDOW];
+    double phaseTimes[WINDOW][PHASE_COUNT];
+    int drawCalls[WINDOW];
+    long long collisionChecks[WINDOW];
+    int head;
+    int count;
+
+    double currentPhases[PHASE_COUNT];
+
+    static double millisecondsBetween(Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    }
+
+public:
+    FrameProfiler() : started(false), head(0), count(0) {
+        std::fill(currentPhases, currentPhases + PHASE_COUNT, 0.0);
+    }
+
+    // Call at the top of every loop iteration. The time since the previous
+    // call is that frame's length.
+    void beginFrame() {
+        Clock::time_point now = Clock::now();
+        if (started) {
+            frameTimes[head] = millisecondsBetween(frameStart, now);
+            std::copy(currentPhases, currentPhases + PHASE_COUNT, phaseTimes[head]);
+            head = (head + 1) % WINDOW;
+            if (count < WINDOW) count++;
+        }
+        started = true;
+        frameStart = phaseStart = now;
+        std::fill(currentPhases, currentPhases + PHASE_COUNT, 0.0);
+    }
+
+    // Charges the time since the last endPhase (or beginFrame) to phase.
+    // A phase may be ended more than once per frame; the times add up.
+    void endPhase(FramePhase phase) {
+        Clock::time_point now = Clock::now();
+        currentPhases[phase] += millisecondsBetween(phaseStart, now);
+        phaseStart = now;
+    }
+
+    // Per-frame counters for the frame that is about to be recorded.
+    void setFrameCounters(int frameDrawCalls, long long frameCollisionChecks) {
+        drawCalls[head] = frameDrawCalls;
+        collisionChecks[head] = frameCollisionChecks;
+    }
+
+    int getSampleCount() const {
+        return count;
+    }
+
+    // p in [0, 1]; 0 if no frame has completed yet.
+    double frameTimePercentile(double p) const {
+        if (count == 0) return 0.0;
+        double sorted[WINDOW];
+        std::copy(frameTimes, frameTimes + count, sorted);
+        int index = std::min(count - 1, (int)(p * count));
+        std::nth_element(sorted, sorted + index, sorted + count);
+        return sorted[index];
+    }
+
+    double frameTimeMax() const {
+        if (count == 0) return 0.0;
+        return *std::max_element(frameTimes, frameTimes + count);
+    }
+
+    double phaseAverage(FramePhase phase) const {
+        if (count == 0) return 0.0;
+        double total = 0.0;
+        for (int i = 0; i < count; i++) total += phaseTimes[i][phase];
+        return total / count;
+    }
+
+    double drawCallsAverage() const {
+        if (count == 0) return 0.0;
+        double total = 0.0;
+        for (int i = 0; i < count; i++) total += drawCalls[i];
+        return total / count;
+    }
+
+    double collisionChecksAverage() const {
+        if (count == 0) return 0.0;
+        double total = 0.0;
+        for (int i = 0; i < count; i++) total += (double)collisionChecks[i];
+        return total / count;
+    }
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "tetrisAnalytics.h"
+#include "tetrisBatch.h"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Answers questions about a corpus of replay files, such as those written by
+// the game's --record option or tetrisHeadless --record-dir. Every .replay
+// file under the given directories (and any file named directly) is
+// analyzed on a work-stealing pool with one worker per core, each with its
+// own ReplayAnalyzer and accumulator, and the accumulators are merged and
+// printed at the end.
+//
+//   tetrisQuery corpus/ [--query clears,topout,kicks] [--threads N]
+
+double percent(long long part, long long whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+void printGames(const ReplayStats& stats) {
+    long long games = stats.files - stats.unreadable;
+    cout << endl << "Recorded results (mean per file)" << endl;
+    cout << "  score:      " << (games ? (double)stats.finalScore / games : 0.0) << endl;
+    cout << "  lines:      " << (games ? (double)stats.finalLines / games : 0.0) << endl;
+    cout << "  pieces:     " << (games ? (double)stats.finalPieces / games : 0.0) << endl;
+}
+
+void printInputs(const ReplayStats& stats) {
+    cout << endl << "Inputs" << endl;
+    for (int i = 0; i < INPUT_COUNT; i++) {
+        cout << "  " << GAME_INPUT_NAMES[i] << ":\t" << stats.inputCounts[i]
+             << "\t(" << percent(stats.inputCounts[i], stats.inputs) << "%)" << endl;
+    }
+}
+
+void printClears(const ReplayStats& stats) {
+    cout << endl << "Lines cleared at once, per level (% of clearing pieces)" << endl;
+    cout << "  level\tclears\t1\t2\t3\t4" << endl;
+    for (int level = 1; level <= ReplayStats::MAX_LEVEL; level++) {
+        const long long* counts = stats.clears[level];
+        long long total = counts[1] + counts[2] + counts[3] + counts[4];
+        if (!total) continue;
+        cout << "  " << level << (level == ReplayStats::MAX_LEVEL ? "+" : "") << "\t" << total;
+        for (int n = 1; n <= 4; n++) {
+            cout << "\t" << percent(counts[n], total);
+        }
+        cout << endl;
+    }
+}
+
+void printTopOut(const ReplayStats& stats) {
+    long long sum = 0;
+    long long largest = 1;
+    for (int h = 0; h <= GRID_HEIGHT; h++) {
+        sum += h * stats.topOutHeights[h];
+        largest = max(largest, stats.topOutHeights[h]);
+    }
+    cout << endl << "Stack height at game over" << endl;
+    cout << "  game overs: " << stats.gameOvers << endl;
+    cout << "  mean:       " << (stats.gameOvers ? (double)sum / stats.gameOvers : 0.0) << " rows" << endl;
+    for (int h = 0; h <= GRID_HEIGHT; h++) {
+        if (!stats.topOutHeights[h]) continue;
+        cout << "  " << h << "\t" << stats.topOutHeights[h] << "\t"
+             << string((size_t)(40 * stats.topOutHeights[h] / largest), '#') << endl;
+    }
+}
+
+void printKicks(const ReplayStats& stats) {
+    cout << endl << "Rotations" << endl;
+    cout << "  rotations:  " << stats.rotations << endl;
+    cout << "  kicked:     " << percent(stats.rotations - stats.kicks[0] - stats.failedRotations, stats.rotations) << "%" << endl;
+    for (int i = 0; i < KICK_COUNT; i++) {
+        const CellOffset& kick = PIECE_TABLE.pieces[0].kicks[0][i];
+        cout << "  (" << (int)kick.x << ", " << (int)kick.y << "):\t" << stats.kicks[i]
+             << "\t(" << percent(stats.kicks[i], stats.rotations) << "%)" << endl;
+    }
+    cout << "  failed:\t" << stats.failedRotations << "\t(" << percent(stats.failedRotations, stats.rotations) << "%)" << endl;
+}
+
+bool parseQueries(const char* list, uint32_t& queries) {
+    queries = 0;
+    string text = list;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == string::npos) comma = text.size();
+        string name = text.substr(start, comma - start);
+        bool found = name == "all";
+        if (found) queries |= QUERY_ALL;
+        for (int i = 0; i < REPLAY_QUERY_COUNT && !found; i++) {
+            if (name == REPLAY_QUERY_NAMES[i]) {
+                queries |= 1u << i;
+                found = true;
+            }
+        }
+        if (!found) return false;
+        start = comma + 1;
+    }
+    return queries != 0;
+}
+
+int main(int argc, char** argv) {
+    uint32_t queries = QUERY_ALL;
+    int threads = 0;
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--query") == 0 && i + 1 < argc) {
+            if (!parseQueries(argv[++i], queries)) {
+                cerr << "Unknown query in " << argv[i] << "; choose from all, games, inputs, clears, topout, kicks" << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            paths.push_back(argv[i]);
+        } else {
+            paths.clear();
+            break;
+        }
+    }
+    if (paths.empty()) {
+        cerr << "Usage: " << argv[0] << " <dir or file>... [--query all|games,inputs,clears,topout,kicks] [--threads N]" << endl;
+        return 1;
+    }
+
+    // Only the names are kept in memory; the files are opened one at a time.
+    vector<string> files;
+    for (const string& path : paths) {
+        error_code error;
+        if (filesystem::is_directory(path, error)) {
+            for (filesystem::recursive_directory_iterator it(path, error), end; it != end; it.increment(error)) {
+                if (it->is_regular_file(error) && it->path().extension() == ".replay") {
+                    files.push_back(it->path().string());
+                }
+            }
+        } else {
+            files.push_back(path);
+        }
+    }
+
+    WorkStealingPool pool(threads);
+    vector<unique_ptr<ReplayAnalyzer>> analyzers;
+    vector<ReplayStats> workerStats(pool.getThreadCount());
+    for (int w = 0; w < pool.getThreadCount(); w++) {
+        analyzers.emplace_back(new ReplayAnalyzer(queries));
+    }
+
+    auto start = chrono::steady_clock::now();
+    pool.run((long long)files.size(), [&](long long i, int w) {
+        analyzers[w]->analyze(files[i].c_str(), workerStats[w]);
+    });
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    ReplayStats stats;
+    for (const ReplayStats& partial : workerStats) {
+        stats.merge(partial);
+    }
+
+    cout << "files:        " << stats.files << " (" << stats.unreadable << " unreadable)" << endl;
+    cout << "play time:    " << (double)stats.ticks / TICKS_PER_SECOND / 3600 << " hours" << endl;
+    cout << "inputs:       " << stats.inputs << endl;
+    cout << "threads:      " << pool.getThreadCount() << endl;
+    cout << "elapsed (s):  " << elapsed << endl;
+    cout << "files/sec:    " << (elapsed > 0 ? stats.files / elapsed : 0.0) << endl;
+    if (queries & QUERIES_NEEDING_SIMULATION) {
+        cout << "ticks/sec:    " << (elapsed > 0 ? stats.ticks / elapsed : 0.0) << " simulated" << endl;
+    }
+
+    if (queries & QUERY_GAMES) printGames(stats);
+    if (queries & QUERY_INPUTS) printInputs(stats);
+    if (queries & QUERY_CLEARS) printClears(stats);
+    if (queries & QUERY_TOP_OUT) printTopOut(stats);
+    if (queries & QUERY_KICKS) printKicks(stats);
+    return stats.unreadable ? 2 : 0;
+}
@@ -0,0 +1,232 @@
+#ifndef TETRIS_RANDOM_H
+#define TETRIS_RANDOM_H
+
+// Random numbers for the game. Pcg32 is a 16-byte generator with
+// independent streams: one seed can drive the piece sequence on one stream
+// and, in the headless runner, the random player's choices on another, and
+// split() hands a worker a generator of its own. PieceGenerator picks
+// pieces from it by one of two rules:
+//   RANDOMIZER_UNIFORM  every piece is any of the seven with equal chance
+//   RANDOMIZER_BAG      the seven pieces are dealt in shuffled bags of seven
+// Its whole state is 16 bytes of plain data, so it is saved and restored
+// along with the rest of a game.
+
+#include "tetrisPieces.h"
+#include <cstdint>
+#include <cstring>
+
+// PCG-XSH-RR: a 64-bit LCG whose state is permuted into 32-bit outputs.
+// Each odd increment is a separate stream. Meets the standard library's
+// UniformRandomBitGenerator requirements, so it works with its
+// distributions too.
+class Pcg32 {
+public:
+    typedef uint32_t result_type;
+
+private:
+    static const uint64_t MULTIPLIER = 6364136223846793005ull;
+
+    uint64_t state;
+    uint64_t increment;
+
+public:
+    explicit Pcg32(uint64_t seedValue = 0, uint64_t stream = 0) {
+        seed(seedValue, stream);
+    }
+
+    static uint64_t streamIncrement(uint64_t stream) {
+        return stream << 1 | 1;
+    }
+
+    // The generator's steps on a bare state word, for holders that keep the
+    // increment implied rather than stored.
+    static uint32_t advance(uint64_t& state, uint64_t increment) {
+        uint64_t old = state;
+        state = old * MULTIPLIER + increment;
+        uint32_t shifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        uint32_t rotation = (uint32_t)(old >> 59);
+        return shifted >> rotation | shifted << ((32 - rotation) & 31);
+    }
+
+    static uint64_t seededState(uint64_t seedValue, uint64_t increment) {
+        uint64_t state = 0;
+        advance(state, increment);
+        state += seedValue;
+        advance(state, increment);
+        return state;
+    }
+
+    // Uniform in [0, bound) from a source of 32-bit outputs: the high half
+    // of a 32x32-bit product, with the few low products that would bias it
+    // rejected.
+    template <typename Next>
+    static uint32_t bounded(uint32_t bound, Next next) {
+        uint64_t product = (uint64_t)next() * bound;
+        uint32_t low = (uint32_t)product;
+        if (low < bound) {
+            uint32_t threshold = (0u - bound) % bound;
+            while (low < threshold) {
+                product = (uint64_t)next() * bound;
+                low = (uint32_t)product;
+            }
+        }
+        return (uint32_t)(product >> 32);
+    }
+
+    void seed(uint64_t seedValue, uint64_t stream = 0) {
+        increment = streamIncrement(stream);
+        state = seededState(seedValue, increment);
+    }
+
+    uint32_t next() {
+        return advance(state, increment);
+    }
+
+    uint32_t bounded(uint32_t bound) {
+        return bounded(bound, [this]() { return next(); });
+    }
+
+    // A generator on a new stream seeded from this one, for a parallel
+    // worker or sub-task.
+    Pcg32 split() {
+        uint64_t seedValue = (uint64_t)next() << 32 | next();
+        uint64_t stream = (uint64_t)next() << 32 | next();
+        return Pcg32(seedValue, stream);
+    }
+
+    result_type operator()() {
+        return next();
+    }
+
+    static constexpr result_type min() {
+        return 0;
+    }
+
+    static constexpr result_type max() {
+        return 0xffffffffu;
+    }
+
+    bool operator==(const Pcg32& other) const {
+        return state == other.state && increment == other.increment;
+    }
+};
+
+enum PieceRandomizer : uint8_t {
+    RANDOMIZER_UNIFORM,
+    RANDOMIZER_BAG,
+    RANDOMIZER_COUNT
+};
+
+inline const char* randomizerName(PieceRandomizer randomizer) {
+    return randomizer == RANDOMIZER_BAG ? "bag" : "uniform";
+}
+
+// Parses "uniform" or "bag". Returns false for anything else.
+inline bool parseRandomizer(const char* name, PieceRandomizer& randomizer) {
+    for (int r = 0; r < RANDOMIZER_COUNT; r++) {
+        if (strcmp(name, randomizerName((PieceRandomizer)r)) == 0) {
+            randomizer = (PieceRandomizer)r;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The Pcg32 state word alone on a fixed stream, plus the randomizer and the
+// current bag packed into one word, 16 bytes in all.
+class PieceGenerator {
+public:
+    // The Pcg32 stream pieces are drawn from.
+    static const uint64_t STREAM = 0;
+    // Bits per piece type in the packed bag.
+    static const int BAG_BITS = 3;
+
+private:
+    uint64_t state;
+    // The current bag's pieces, BAG_BITS each with the first piece dealt
+    // highest, and how many are left.
+    uint32_t bag;
+    PieceRandomizer randomizer;
+    uint8_t bagLeft;
+
+    uint32_t bounded(uint32_t bound) {
+        return Pcg32::bounded(bound, [this]() { return Pcg32::advance(state, Pcg32::streamIncrement(STREAM)); });
+    }
+
+    static int bagPiece(uint32_t bag, int i) {
+        return (int)(bag >> (i * BAG_BITS) & ((1u << BAG_BITS) - 1));
+    }
+
+    // Fisher-Yates shuffle of the seven types into the packed slots.
+    void refillBag() {
+        uint8_t order[PIECE_TYPES];
+        for (int i = 0; i < PIECE_TYPES; i++) {
+            order[i] = (uint8_t)i;
+        }
+        for (int i = PIECE_TYPES - 1; i > 0; i--) {
+            int j = (int)bounded((uint32_t)i + 1);
+            uint8_t swap = order[i];
+            order[i] = order[j];
+            order[j] = swap;
+        }
+        bag = 0;
+        for (int i = 0; i < PIECE_TYPES; i++) {
+            bag |= (uint32_t)order[i] << (i * BAG_BITS);
+        }
+        bagLeft = PIECE_TYPES;
+    }
+
+public:
+    explicit PieceGenerator(uint32_t seedValue = 0, PieceRandomizer randomizer = RANDOMIZER_UNIFORM)
+        : state(Pcg32::seededState(seedValue, Pcg32::streamIncrement(STREAM))), bag(0), randomizer(randomizer),
+          bagLeft(0) {}
+
+    // Restarts the sequence; both rules start with a fresh bag.
+    void seed(uint32_t seedValue) {
+        state = Pcg32::seededState(seedValue, Pcg32::streamIncrement(STREAM));
+        bagLeft = 0;
+    }
+
+    void setRandomizer(PieceRandomizer newRandomizer) {
+        randomizer = newRandomizer;
+        bagLeft = 0;
+    }
+
+    PieceRandomizer getRandomizer() const {
+        return randomizer;
+    }
+
+    // Whether the state could have come from this class, for generators
+    // read back from a file: a known randomizer, at most a full bag left,
+    // a piece type in every slot of the bag and no type twice among the
+    // slots still to be dealt.
+    bool isValid() const {
+        if (randomizer >= RANDOMIZER_COUNT || bagLeft > PIECE_TYPES || bag >> (PIECE_TYPES * BAG_BITS)) return false;
+        unsigned int left = 0;
+        for (int i = 0; i < PIECE_TYPES; i++) {
+            int piece = bagPiece(bag, i);
+            if (piece >= PIECE_TYPES) return false;
+            if (i >= bagLeft) continue;
+            if (left & (1u << piece)) return false;
+            left |= 1u << piece;
+        }
+        return true;
+    }
+
+    int next() {
+        if (randomizer == RANDOMIZER_BAG) {
+            if (bagLeft == 0) refillBag();
+            return bagPiece(bag, --bagLeft);
+        }
+        return (int)bounded(PIECE_TYPES);
+    }
+
+    bool operator==(const PieceGenerator& other) const {
+        return state == other.state && randomizer == other.randomizer && bagLeft == other.bagLeft &&
+               bag == other.bag;
+    }
+};
+
+static_assert(sizeof(PieceGenerator) == 16, "PieceGenerator is part of every saved game");
+
+#endif
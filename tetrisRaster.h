@@ -0,0 +1,968 @@
+#ifndef TETRIS_RASTER_H
+#define TETRIS_RASTER_H
+
+// A software renderer for machines with no GPU or OpenGL at all: replay
+// thumbnails, golden-image tests and server-side previews. SoftwareCanvas
+// is a TetrisScene canvas, so it draws the same layout as the window, into
+// an RGBA Framebuffer in memory that can be written out as PPM or PNG.
+//
+// Everything on screen is an opaque axis-aligned rectangle, so rasterizing
+// is filling row spans, done with 128- or 256-bit stores. A pixel is
+// covered when its center is inside the rectangle, left and top edges
+// inclusive, as in OpenGL.
+//
+// Layers are cached the same way LayerCache caches them on the GPU, and
+// the frame is never cleared: when a frame composites the same layers as
+// the last one, only the area drawn over since (the previous falling piece)
+// is copied back, so an idle frame touches a few thousand pixels. Each layer
+// also keeps the few rectangles it has drawn into, so re-rendering one
+// clears only those and the frame takes back only what changed, rather
+// than whole windows of the clear color.
+//
+// A frame that redraws every layer, as one does when the board changes
+// every tick, skips the buffers: each layer is drawn straight onto the
+// frame where it shows, and what its last drawing filled and this one did
+// not is cleared and filled back from the new one. That writes each pixel
+// about once instead of clearing, filling and copying it.
+//
+// NullCanvas goes through the same motions and writes no pixels at all.
+
+#include "tetrisDraw.h"
+#include "tetrisFont.h"
+#include "tetrisScene.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define TETRIS_RASTER_SSE2 1
+#endif
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1).
+struct PixelRect {
+    int x0, y0, x1, y1;
+
+    bool empty() const {
+        return x0 >= x1 || y0 >= y1;
+    }
+
+    PixelRect intersect(const PixelRect& other) const {
+        return {std::max(x0, other.x0), std::max(y0, other.y0), std::min(x1, other.x1), std::min(y1, other.y1)};
+    }
+
+    PixelRect unite(const PixelRect& other) const {
+        if (empty()) return other;
+        if (other.empty()) return *this;
+        return {std::min(x0, other.x0), std::min(y0, other.y0), std::max(x1, other.x1), std::max(y1, other.y1)};
+    }
+
+    bool operator==(const PixelRect& other) const {
+        return x0 == other.x0 && y0 == other.y0 && x1 == other.x1 && y1 == other.y1;
+    }
+
+    // The pixels whose centers fall inside [x0, x1) x (y0, y1]. GL's window
+    // y runs bottom-up, so a center exactly on an edge goes to the rectangle
+    // above it on screen, where x ties go to the right.
+    static PixelRect covering(float x0, float y0, float x1, float y1) {
+        return {(int)std::ceil(x0 - 0.5f), (int)std::floor(y0 - 0.5f) + 1,
+                (int)std::ceil(x1 - 0.5f), (int)std::floor(y1 - 0.5f) + 1};
+    }
+};
+
+// A few rectangles covering an area, for tracking what has been drawn.
+// A rectangle inside one already held adds nothing; past MAX_RECTS a new
+// one is merged into whichever held rectangle grows least by taking it in,
+// so the area covered can only grow.
+class PixelRegion {
+public:
+    static const int MAX_RECTS = 16;
+
+private:
+    PixelRect rects[MAX_RECTS];
+    int count;
+
+    static long long area(const PixelRect& r) {
+        return r.empty() ? 0 : (long long)(r.x1 - r.x0) * (r.y1 - r.y0);
+    }
+
+    static bool contains(const PixelRect& outer, const PixelRect& inner) {
+        return outer.x0 <= inner.x0 && outer.y0 <= inner.y0 && outer.x1 >= inner.x1 && outer.y1 >= inner.y1;
+    }
+
+public:
+    PixelRegion() : count(0) {}
+
+    void clear() {
+        count = 0;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    const PixelRect& operator[](int i) const {
+        return rects[i];
+    }
+
+    void add(const PixelRect& rect) {
+        if (rect.empty()) return;
+        int kept = 0;
+        for (int i = 0; i < count; i++) {
+            if (contains(rects[i], rect)) return;
+            if (!contains(rect, rects[i])) rects[kept++] = rects[i];
+        }
+        count = kept;
+        if (count < MAX_RECTS) {
+            rects[count++] = rect;
+            return;
+        }
+        int best = 0;
+        long long bestGrowth = -1;
+        for (int i = 0; i < count; i++) {
+            long long growth = area(rects[i].unite(rect)) - area(rects[i]);
+            if (bestGrowth < 0 || growth < bestGrowth) {
+                best = i;
+                bestGrowth = growth;
+            }
+        }
+        rects[best] = rects[best].unite(rect);
+    }
+
+    void add(const PixelRegion& other) {
+        for (int i = 0; i < other.count; i++) {
+            add(other.rects[i]);
+        }
+    }
+
+    // Whether rect is inside one of the rectangles.
+    bool covers(const PixelRect& rect) const {
+        for (int i = 0; i < count; i++) {
+            if (contains(rects[i], rect)) return true;
+        }
+        return false;
+    }
+};
+
+// Packs a color as bytes R, G, B, A in memory, rounding like the GPU's
+// conversion to 8-bit channels.
+inline uint32_t packColor(const float color[3], float brightness = 1.0f) {
+    uint8_t bytes[4];
+    for (int c = 0; c < 3; c++) {
+        float value = std::min(std::max(color[c] * brightness, 0.0f), 1.0f);
+        bytes[c] = (uint8_t)(value * 255.0f + 0.5f);
+    }
+    bytes[3] = 255;
+    uint32_t pixel;
+    memcpy(&pixel, bytes, sizeof(pixel));
+    return pixel;
+}
+
+class Framebuffer {
+private:
+    int width;
+    int height;
+    std::vector<uint32_t> pixels;
+
+    static void fillSpan(uint32_t* out, int count, uint32_t pixel) {
+#if defined(__AVX__)
+        const __m256i wide = _mm256_set1_epi32((int)pixel);
+        for (; count >= 8; count -= 8, out += 8) {
+            _mm256_storeu_si256((__m256i*)out, wide);
+        }
+#endif
+#ifdef TETRIS_RASTER_SSE2
+        const __m128i quad = _mm_set1_epi32((int)pixel);
+        for (; count >= 4; count -= 4, out += 4) {
+            _mm_storeu_si128((__m128i*)out, quad);
+        }
+#endif
+        for (; count > 0; count--) {
+            *out++ = pixel;
+        }
+    }
+
+public:
+    Framebuffer(int width, int height) : width(width), height(height), pixels((size_t)width * height) {}
+
+    int getWidth() const {
+        return width;
+    }
+
+    int getHeight() const {
+        return height;
+    }
+
+    PixelRect bounds() const {
+        return {0, 0, width, height};
+    }
+
+    const uint32_t* row(int y) const {
+        return &pixels[(size_t)y * width];
+    }
+
+    void fill(const PixelRect& area, uint32_t pixel) {
+        PixelRect r = area.intersect(bounds());
+        if (r.empty()) return;
+        for (int y = r.y0; y < r.y1; y++) {
+            fillSpan(&pixels[(size_t)y * width + r.x0], r.x1 - r.x0, pixel);
+        }
+    }
+
+    // Copies area from another framebuffer of the same size.
+    void copy(const Framebuffer& from, const PixelRect& area) {
+        PixelRect r = area.intersect(bounds());
+        if (r.empty()) return;
+        for (int y = r.y0; y < r.y1; y++) {
+            memcpy(&pixels[(size_t)y * width + r.x0], from.row(y) + r.x0, (r.x1 - r.x0) * sizeof(uint32_t));
+        }
+    }
+
+    bool operator==(const Framebuffer& other) const {
+        return width == other.width && height == other.height && pixels == other.pixels;
+    }
+
+    // The pixels as tightly packed 8-bit RGB rows, top row first.
+    void toRGB(std::vector<uint8_t>& out) const {
+        out.resize((size_t)width * height * 3);
+        uint8_t* to = out.data();
+        for (uint32_t pixel : pixels) {
+            uint8_t bytes[4];
+            memcpy(bytes, &pixel, sizeof(bytes));
+            *to++ = bytes[0];
+            *to++ = bytes[1];
+            *to++ = bytes[2];
+        }
+    }
+
+    bool writePPM(const char* path) const {
+        FILE* file = fopen(path, "wb");
+        if (!file) return false;
+        std::vector<uint8_t> rgb;
+        toRGB(rgb);
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        return fclose(file) == 0 && ok;
+    }
+
+    bool writePNG(const char* path) const;
+
+    // Picks the format from the extension: .ppm, otherwise PNG.
+    bool write(const char* path) const {
+        size_t length = strlen(path);
+        if (length >= 4 && strcmp(path + length - 4, ".ppm") == 0) return writePPM(path);
+        return writePNG(path);
+    }
+};
+
+// Minimal PNG encoder. Rows use the Sub filter, which turns the flat colors
+// of a frame into runs of zeros, and the deflate stream is a single block
+// with the fixed Huffman code, matching only against one byte back or the
+// same spot on the previous row. That is enough to shrink a frame to a few
+// tens of kilobytes without a zlib dependency.
+class PngEncoder {
+private:
+    std::vector<uint8_t> out;
+    uint32_t bitBuffer;
+    int bitCount;
+
+    static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+        static uint32_t table[256];
+        static bool built = false;
+        if (!built) {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            built = true;
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    static uint32_t adler32(const std::vector<uint8_t>& data) {
+        uint32_t a = 1;
+        uint32_t b = 0;
+        for (size_t i = 0; i < data.size();) {
+            // 5552 bytes is the most that cannot overflow before the modulo.
+            size_t end = std::min(data.size(), i + 5552);
+            for (; i < end; i++) {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    void putU32(std::vector<uint8_t>& to, uint32_t value) {
+        to.push_back((uint8_t)(value >> 24));
+        to.push_back((uint8_t)(value >> 16));
+        to.push_back((uint8_t)(value >> 8));
+        to.push_back((uint8_t)value);
+    }
+
+    void chunk(const char type[4], const std::vector<uint8_t>& data) {
+        putU32(out, (uint32_t)data.size());
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        putU32(out, crc32(&out[start], out.size() - start));
+    }
+
+    // Deflate writes fields least significant bit first.
+    void putBits(std::vector<uint8_t>& to, uint32_t value, int count) {
+        bitBuffer |= value << bitCount;
+        bitCount += count;
+        while (bitCount >= 8) {
+            to.push_back((uint8_t)bitBuffer);
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+    }
+
+    // Huffman codes are stored most significant bit first.
+    void putCode(std::vector<uint8_t>& to, uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++) {
+            reversed |= ((code >> i) & 1) << (length - 1 - i);
+        }
+        putBits(to, reversed, length);
+    }
+
+    void putLiteral(std::vector<uint8_t>& to, int symbol) {
+        if (symbol < 144) putCode(to, 0x30 + symbol, 8);
+        else if (symbol < 256) putCode(to, 0x190 + symbol - 144, 9);
+        else if (symbol < 280) putCode(to, symbol - 256, 7);
+        else putCode(to, 0xc0 + symbol - 280, 8);
+    }
+
+    void putMatch(std::vector<uint8_t>& to, int length, int distance) {
+        static const int LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const int LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                             3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const int DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                              193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                              6145, 8193, 12289, 16385, 24577};
+        static const int DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        int l = 28;
+        while (LENGTH_BASE[l] > length) l--;
+        putLiteral(to, 257 + l);
+        putBits(to, length - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+        int d = 29;
+        while (DISTANCE_BASE[d] > distance) d--;
+        putCode(to, d, 5);
+        putBits(to, distance - DISTANCE_BASE[d], DISTANCE_EXTRA[d]);
+    }
+
+    static int matchLength(const std::vector<uint8_t>& data, size_t at, size_t distance) {
+        if (at < distance) return 0;
+        size_t limit = std::min(data.size() - at, (size_t)258);
+        size_t n = 0;
+        while (n < limit && data[at + n] == data[at + n - distance]) n++;
+        return (int)n;
+    }
+
+    void deflate(const std::vector<uint8_t>& data, size_t rowBytes, std::vector<uint8_t>& to) {
+        bitBuffer = 0;
+        bitCount = 0;
+        to.push_back(0x78);
+        to.push_back(0x01);
+        // Final block, fixed Huffman codes.
+        putBits(to, 1, 1);
+        putBits(to, 1, 2);
+        for (size_t i = 0; i < data.size();) {
+            int run = matchLength(data, i, 1);
+            int up = rowBytes <= 32768 ? matchLength(data, i, rowBytes) : 0;
+            if (up >= 3 && up >= run) {
+                putMatch(to, up, (int)rowBytes);
+                i += up;
+            } else if (run >= 3) {
+                putMatch(to, run, 1);
+                i += run;
+            } else {
+                putLiteral(to, data[i++]);
+            }
+        }
+        putLiteral(to, 256);
+        if (bitCount > 0) putBits(to, 0, 8 - bitCount);
+        putU32(to, adler32(data));
+    }
+
+public:
+    PngEncoder() : bitBuffer(0), bitCount(0) {}
+
+    // rgb holds height rows of width 8-bit RGB pixels.
+    const std::vector<uint8_t>& encode(const std::vector<uint8_t>& rgb, int width, int height) {
+        static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        out.assign(SIGNATURE, SIGNATURE + 8);
+
+        std::vector<uint8_t> header;
+        putU32(header, (uint32_t)width);
+        putU32(header, (uint32_t)height);
+        header.push_back(8);    // bit depth
+        header.push_back(2);    // RGB
+        header.push_back(0);    // deflate
+        header.push_back(0);    // adaptive filtering
+        header.push_back(0);    // no interlace
+        chunk("IHDR", header);
+
+        size_t stride = (size_t)width * 3;
+        std::vector<uint8_t> filtered((stride + 1) * height);
+        for (int y = 0; y < height; y++) {
+            const uint8_t* in = &rgb[y * stride];
+            uint8_t* row = &filtered[y * (stride + 1)];
+            row[0] = 1;
+            for (size_t i = 0; i < stride; i++) {
+                row[1 + i] = (uint8_t)(in[i] - (i >= 3 ? in[i - 3] : 0));
+            }
+        }
+        std::vector<uint8_t> compressed;
+        deflate(filtered, stride + 1, compressed);
+        chunk("IDAT", compressed);
+        chunk("IEND", std::vector<uint8_t>());
+        return out;
+    }
+};
+
+inline bool Framebuffer::writePNG(const char* path) const {
+    std::vector<uint8_t> rgb;
+    toRGB(rgb);
+    PngEncoder encoder;
+    const std::vector<uint8_t>& png = encoder.encode(rgb, width, height);
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+    return fclose(file) == 0 && ok;
+}
+
+// TetrisScene canvas that rasterizes into a WINDOW_WIDTH x WINDOW_HEIGHT
+// Framebuffer. Rectangles are filled as they come, so flush() has nothing
+// to do.
+class SoftwareCanvas {
+private:
+    static const int MAX_COMPOSITES = 8;
+    static const int MAX_PARTS = 8;
+    // How far ahead of the last match a redrawn layer's old fills are
+    // searched for one its new fill repeats.
+    static const size_t MATCH_WINDOW = 16;
+
+    struct Composite {
+        Layer layer;
+        PixelRect area;
+
+        bool operator==(const Composite& other) const {
+            return layer == other.layer && area == other.area;
+        }
+    };
+
+    // A rectangle filled in one color, already clipped to the frame.
+    struct Fill {
+        PixelRect area;
+        uint32_t pixel;
+    };
+
+    // Where a composite shows: its area less the areas composited after it.
+    struct VisibleParts {
+        PixelRect parts[MAX_PARTS];
+        int count;
+
+        // Takes away area, unless the parts left would not fit.
+        bool cut(const PixelRect& area) {
+            PixelRect left[MAX_PARTS];
+            int leftCount = 0;
+            for (int i = 0; i < count; i++) {
+                const PixelRect& part = parts[i];
+                PixelRect overlap = part.intersect(area);
+                PixelRect pieces[4] = {part, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}};
+                if (!overlap.empty()) {
+                    pieces[0] = {part.x0, part.y0, part.x1, overlap.y0};
+                    pieces[1] = {part.x0, overlap.y1, part.x1, part.y1};
+                    pieces[2] = {part.x0, overlap.y0, overlap.x0, overlap.y1};
+                    pieces[3] = {overlap.x1, overlap.y0, part.x1, overlap.y1};
+                }
+                for (const PixelRect& piece : pieces) {
+                    if (piece.empty()) continue;
+                    if (leftCount == MAX_PARTS) return false;
+                    left[leftCount++] = piece;
+                }
+            }
+            std::copy(left, left + leftCount, parts);
+            count = leftCount;
+            return true;
+        }
+    };
+
+    Framebuffer frame;
+    std::vector<Framebuffer> layerBuffers;
+    bool valid[LAYER_COUNT];
+    int renderCounts[LAYER_COUNT];
+    // Where each layer holds anything but the clear color, and where it
+    // has changed since it was last composited.
+    PixelRegion layerDrawn[LAYER_COUNT];
+    PixelRegion layerChanged[LAYER_COUNT];
+    Framebuffer* target;
+    Layer targetLayer;
+    QuadBatch textQuads;
+
+    // Composites are queued and copied when something is drawn on top or
+    // the frame ends, by which point it is known whether they repeat the
+    // last frame's.
+    Composite composites[MAX_COMPOSITES];
+    Composite lastComposites[MAX_COMPOSITES];
+    int compositeCount;
+    int lastCompositeCount;
+    int compositesCopied;
+    // Set for a frame with more composites than fit, and the one after.
+    bool overflowed;
+    bool lastOverflowed;
+    // What was drawn straight onto the frame, this frame and the last.
+    PixelRect drawn;
+    PixelRect lastDrawn;
+    long long pixelsFilled;
+    long long pixelsCopied;
+
+    // Every fill of each layer's last render, and of what was drawn straight
+    // onto the frame this frame and the last, in order. Together with the
+    // last frame's composites they say what each pixel of the frame holds.
+    std::vector<Fill> layerFills[LAYER_COUNT];
+    std::vector<Fill> frameFills;
+    std::vector<Fill> lastFrameFills;
+    // Invalidated since the last render, and rendered this frame and the last.
+    bool invalidated[LAYER_COUNT];
+    bool rendered[LAYER_COUNT];
+    bool lastRendered[LAYER_COUNT];
+    // A direct frame draws the last frame's composited layers, in the same
+    // order, straight onto the frame, each only where it shows. directCount
+    // of them have been drawn so far; the layers drawn are in drawnDirect.
+    bool direct;
+    bool directChecked;
+    int directCount;
+    bool drawnDirect[LAYER_COUNT];
+    VisibleParts visible[MAX_COMPOSITES];
+    // Whether what the last frame drew on top has been painted out.
+    bool frameRepaired;
+    // The fills of the layer being drawn directly as of its last render,
+    // which of them its new fills repeat, and where matching has got to.
+    std::vector<Fill> oldFills;
+    std::vector<uint8_t> oldKept;
+    size_t oldMatched;
+
+    void fillArea(Framebuffer& to, const PixelRect& area, uint32_t pixel) {
+        if (area.empty()) return;
+        to.fill(area, pixel);
+        pixelsFilled += (long long)(area.x1 - area.x0) * (area.y1 - area.y0);
+    }
+
+    // Clears part of the frame and fills it again from fills, in order.
+    void repaint(const PixelRect& part, const std::vector<Fill>& fills) {
+        if (part.empty()) return;
+        frame.fill(part, packColor(CLEAR_COLOR));
+        for (const Fill& fill : fills) {
+            fillArea(frame, fill.area.intersect(part), fill.pixel);
+        }
+    }
+
+    // A frame can skip the layer buffers when it redraws every layer the
+    // last one composited and those were redrawn last frame as well, so
+    // the layers are churning rather than changing once, and when the
+    // frame holds nothing but the last frame's composites and what was
+    // drawn on top of them. A layer drawn directly stays invalid, since its
+    // buffer still holds the old drawing.
+    bool canDrawDirect() {
+        if (overflowed || lastOverflowed || lastCompositeCount == 0 || compositeCount > 0 || !frameFills.empty()) {
+            return false;
+        }
+        for (int i = 0; i < lastCompositeCount; i++) {
+            Layer layer = lastComposites[i].layer;
+            if (!invalidated[layer] || !lastRendered[layer]) return false;
+            for (int j = 0; j < i; j++) {
+                if (lastComposites[j].layer == layer) return false;
+            }
+            visible[i].count = 0;
+            if (!lastComposites[i].area.empty()) visible[i].parts[visible[i].count++] = lastComposites[i].area;
+            for (int j = i + 1; j < lastCompositeCount; j++) {
+                if (!visible[i].cut(lastComposites[j].area)) return false;
+            }
+        }
+        return true;
+    }
+
+    // Once the direct layers are drawn, where the last frame drew on top of
+    // them is put back to what they now hold.
+    void repairFrame() {
+        if (frameRepaired) return;
+        frameRepaired = true;
+        for (const Fill& fill : lastFrameFills) {
+            for (int i = 0; i < directCount; i++) {
+                for (int p = 0; p < visible[i].count; p++) {
+                    repaint(fill.area.intersect(visible[i].parts[p]), layerFills[lastComposites[i].layer]);
+                }
+            }
+        }
+    }
+
+    // Corners are computed as the quad shader computes them, x + w as
+    // w + x and so on, so edges round the same way.
+    void fillRect(float x0, float y0, float x1, float y1, uint32_t pixel) {
+        PixelRect area = PixelRect::covering(x0, y0, x1, y1).intersect(frame.bounds());
+        if (area.empty()) return;
+        if (targetLayer == LAYER_COUNT) {
+            repairFrame();
+            copyComposites();
+            drawn = drawn.unite(area);
+            frameFills.push_back({area, pixel});
+            fillArea(frame, area, pixel);
+            return;
+        }
+        layerFills[targetLayer].push_back({area, pixel});
+        if (target != &frame) {
+            layerDrawn[targetLayer].add(area);
+            fillArea(*target, area, pixel);
+            return;
+        }
+        // An old fill of the same rectangle is painted over by this one.
+        size_t end = std::min(oldFills.size(), oldMatched + MATCH_WINDOW);
+        for (size_t i = oldMatched; i < end; i++) {
+            if (oldFills[i].area == area) {
+                oldKept[i] = 1;
+                oldMatched = i + 1;
+                break;
+            }
+        }
+        const VisibleParts& shown = visible[directCount];
+        for (int p = 0; p < shown.count; p++) {
+            fillArea(frame, area.intersect(shown.parts[p]), pixel);
+        }
+    }
+
+    void copyArea(Layer layer, const PixelRect& area) {
+        frame.copy(layerBuffers[layer], area);
+        if (!area.empty()) pixelsCopied += (long long)(area.x1 - area.x0) * (area.y1 - area.y0);
+    }
+
+    // If this frame composites the same layers to the same places as the
+    // last one, the frame already holds them everywhere except where the
+    // last frame drew over them and where a layer has changed since, so
+    // only that area is copied, and none of it where a later composite
+    // covers it anyway.
+    //
+    // Layers drawn directly are on the frame already. Their buffers are
+    // stale, so what changed in them stays marked for the next copy.
+    void copyComposites() {
+        if (compositesCopied == compositeCount) return;
+        bool repeat = !overflowed && !lastOverflowed && directCount == 0 && compositesCopied == 0 &&
+                      compositeCount == lastCompositeCount &&
+                      std::equal(composites, composites + compositeCount, lastComposites);
+        if (repeat) {
+            PixelRegion stale;
+            stale.add(lastDrawn);
+            for (int i = 0; i < compositeCount; i++) {
+                stale.add(layerChanged[composites[i].layer]);
+            }
+            for (int i = 0; i < compositeCount; i++) {
+                PixelRegion later;
+                for (int j = i + 1; j < compositeCount; j++) {
+                    later.add(composites[j].area);
+                }
+                for (int s = 0; s < stale.size(); s++) {
+                    PixelRect area = composites[i].area.intersect(stale[s]);
+                    if (!later.covers(area)) copyArea(composites[i].layer, area);
+                }
+            }
+        } else {
+            for (int i = compositesCopied; i < compositeCount; i++) {
+                if (!drawnDirect[composites[i].layer]) copyArea(composites[i].layer, composites[i].area);
+            }
+        }
+        for (int i = compositesCopied; i < compositeCount; i++) {
+            if (!drawnDirect[composites[i].layer]) layerChanged[composites[i].layer].clear();
+        }
+        compositesCopied = compositeCount;
+    }
+
+public:
+    SoftwareCanvas()
+        : frame(WINDOW_WIDTH, WINDOW_HEIGHT), layerBuffers(LAYER_COUNT, Framebuffer(WINDOW_WIDTH, WINDOW_HEIGHT)),
+          target(&frame), targetLayer(LAYER_COUNT), compositeCount(0), lastCompositeCount(0), compositesCopied(0),
+          overflowed(false), lastOverflowed(false), drawn{0, 0, 0, 0}, lastDrawn{0, 0, 0, 0}, pixelsFilled(0), pixelsCopied(0),
+          direct(false), directChecked(false), directCount(0), frameRepaired(false), oldMatched(0) {
+        for (int i = 0; i < LAYER_COUNT; i++) {
+            valid[i] = false;
+            renderCounts[i] = 0;
+            invalidated[i] = rendered[i] = lastRendered[i] = drawnDirect[i] = false;
+            layerBuffers[i].fill(layerBuffers[i].bounds(), packColor(CLEAR_COLOR));
+        }
+        frame.fill(frame.bounds(), packColor(CLEAR_COLOR));
+    }
+
+    void rect(float x, float y, float w, float h, const float color[3], float brightness = 1.0f) {
+        fillRect(x, y, w + x, h + y, packColor(color, brightness));
+    }
+
+    // Glyph quads are built at the origin and offset, as the GPU draws a
+    // cached text mesh.
+    void text(const std::string& text, float x, float y, const float color[3], float pixelSize) {
+        const float white[3] = {1.0f, 1.0f, 1.0f};
+        textQuads.clear();
+        buildTextQuads(textQuads, text, 0.0f, 0.0f, white, pixelSize);
+        uint32_t pixel = packColor(color);
+        for (size_t i = 0; i < textQuads.size(); i++) {
+            const QuadInstance& q = textQuads.data()[i];
+            fillRect(q.x + x, q.y + y, (q.w + q.x) + x, (q.h + q.y) + y, pixel);
+        }
+    }
+
+    void flush() {}
+
+    // The same picture as BoardRenderer: each cell a BLOCK_SIZE - 1 square
+    // in its piece color, with the clear color showing between them.
+    template <typename Core>
+    void drawBoard(const Core& core) {
+        uint32_t palette[PIECE_TYPES + 1];
+        float background[3];
+        for (int c = 0; c < 3; c++) {
+            background[c] = GRID_BACKGROUND_COLOR[c] * GRID_BACKGROUND_BRIGHTNESS;
+        }
+        palette[0] = packColor(background);
+        for (int type = 0; type < PIECE_TYPES; type++) {
+            palette[type + 1] = packColor(TETROMINO_COLORS[type]);
+        }
+        for (int y = 0; y < Core::VISIBLE_HEIGHT; y++) {
+            for (int x = 0; x < Core::WIDTH; x++) {
+                float left = GRID_OFFSET_X + x * BLOCK_SIZE;
+                float top = GRID_OFFSET_Y + y * BLOCK_SIZE;
+                fillRect(left, top, left + BLOCK_SIZE - 1, top + BLOCK_SIZE - 1,
+                         palette[core.getCell(x, y + Core::HIDDEN_ROWS)]);
+            }
+        }
+    }
+
+    bool beginLayer(Layer layer) {
+        if (valid[layer]) return false;
+        targetLayer = layer;
+        if (!directChecked) {
+            directChecked = true;
+            direct = canDrawDirect();
+        }
+        // Anything out of the last frame's order is drawn into its buffer,
+        // and so is everything after it.
+        if (direct && (directCount == lastCompositeCount || lastComposites[directCount].layer != layer ||
+                       compositeCount > 0 || !frameFills.empty())) {
+            direct = false;
+        }
+        if (direct) {
+            target = &frame;
+            oldFills.swap(layerFills[layer]);
+            layerFills[layer].clear();
+            oldKept.assign(oldFills.size(), 0);
+            oldMatched = 0;
+            return true;
+        }
+        target = &layerBuffers[layer];
+        layerFills[layer].clear();
+        // Only what was drawn last time needs clearing; the old drawing
+        // and the new one are where the layer changes.
+        uint32_t clear = packColor(CLEAR_COLOR);
+        for (int i = 0; i < layerDrawn[layer].size(); i++) {
+            target->fill(layerDrawn[layer][i], clear);
+        }
+        layerChanged[layer].add(layerDrawn[layer]);
+        layerDrawn[layer].clear();
+        return true;
+    }
+
+    void endLayer(Layer layer) {
+        if (target == &frame) {
+            // Old fills the new drawing did not paint over are cleared, with
+            // whatever of the new drawing falls inside them filled back.
+            const VisibleParts& shown = visible[directCount];
+            PixelRect reach = {0, 0, 0, 0};
+            for (const Fill& fill : layerFills[layer]) {
+                reach = reach.unite(fill.area);
+            }
+            for (size_t i = 0; i < oldFills.size(); i++) {
+                if (oldKept[i]) continue;
+                reach = reach.unite(oldFills[i].area);
+                for (int p = 0; p < shown.count; p++) {
+                    repaint(oldFills[i].area.intersect(shown.parts[p]), layerFills[layer]);
+                }
+            }
+            layerChanged[layer].add(reach);
+            drawnDirect[layer] = true;
+            directCount++;
+        } else {
+            layerChanged[layer].add(layerDrawn[layer]);
+            valid[layer] = true;
+        }
+        target = &frame;
+        targetLayer = LAYER_COUNT;
+        invalidated[layer] = false;
+        rendered[layer] = true;
+        renderCounts[layer]++;
+    }
+
+    void composite(Layer layer, float x, float y, float w, float h) {
+        if (compositeCount == MAX_COMPOSITES) {
+            // Too many to compare with the last frame; copy them all.
+            overflowed = true;
+            copyComposites();
+            compositeCount = compositesCopied = 0;
+        }
+        PixelRect area = {(int)x, (int)y, (int)(x + w), (int)(y + h)};
+        composites[compositeCount++] = {layer, area.intersect(frame.bounds())};
+    }
+
+    void invalidate(Layer layer) {
+        valid[layer] = false;
+        invalidated[layer] = true;
+    }
+
+    void beginFrame() {
+        std::copy(composites, composites + compositeCount, lastComposites);
+        lastCompositeCount = compositeCount;
+        compositeCount = compositesCopied = 0;
+        lastDrawn = drawn;
+        drawn = {0, 0, 0, 0};
+        lastOverflowed = overflowed;
+        overflowed = false;
+        lastFrameFills.swap(frameFills);
+        frameFills.clear();
+        for (int i = 0; i < LAYER_COUNT; i++) {
+            lastRendered[i] = rendered[i];
+            rendered[i] = drawnDirect[i] = false;
+        }
+        direct = directChecked = frameRepaired = false;
+        directCount = 0;
+    }
+
+    void endFrame() {
+        repairFrame();
+        copyComposites();
+    }
+
+    const Framebuffer& getFrame() {
+        repairFrame();
+        copyComposites();
+        return frame;
+    }
+
+    int getLayerRenderCount(Layer layer) const {
+        return renderCounts[layer];
+    }
+
+    // Pixels written by fills and by layer copies since construction.
+    long long getPixelsFilled() const {
+        return pixelsFilled;
+    }
+
+    long long getPixelsCopied() const {
+        return pixelsCopied;
+    }
+};
+
+// A canvas with no GPU and no pixels behind it, for timing the CPU side of
+// a frame or running the game loop with no display. Rectangles and glyph
+// runs go into a quad batch that flush() empties, layers are cached the way
+// the window caches them, and drawBoard() unpacks the cells it would upload.
+class NullCanvas {
+private:
+    QuadBatch quads;
+    std::vector<uint8_t> boardCells;
+    bool valid[LAYER_COUNT];
+    long long quadsBuilt;
+    long long composites;
+    // Flushes with quads in them this frame, each of which would be a draw.
+    int frameDraws;
+
+public:
+    NullCanvas() : quadsBuilt(0), composites(0), frameDraws(0) {
+        invalidateAll();
+    }
+
+    void init() {}
+
+    void rect(float x, float y, float w, float h, const float color[3], float brightness = 1.0f) {
+        quads.rect(x, y, w, h, color, brightness);
+    }
+
+    void text(const std::string& text, float x, float y, const float color[3], float pixelSize) {
+        buildTextQuads(quads, text, x, y, color, pixelSize);
+    }
+
+    void flush() {
+        if (quads.size() > 0) frameDraws++;
+        quadsBuilt += (long long)quads.size();
+        quads.clear();
+    }
+
+    void overlayRect(float x, float y, float w, float h, const float color[3]) {
+        rect(x, y, w, h, color);
+    }
+
+    void overlayText(const std::string& text, float x, float y, const float color[3], float pixelSize) {
+        buildTextQuads(quads, text, x, y, color, pixelSize);
+    }
+
+    void flushOverlay() {
+        flush();
+    }
+
+    template <typename Core>
+    void drawBoard(const Core& core) {
+        boardCells.resize(Core::WIDTH * Core::HEIGHT);
+        core.copyCells(boardCells.data());
+        frameDraws++;
+    }
+
+    bool beginLayer(Layer layer) {
+        return !valid[layer];
+    }
+
+    void endLayer(Layer layer) {
+        valid[layer] = true;
+    }
+
+    void composite(Layer, float, float, float, float) {
+        composites++;
+        frameDraws++;
+    }
+
+    void invalidate(Layer layer) {
+        valid[layer] = false;
+    }
+
+    void invalidateAll() {
+        for (int i = 0; i < LAYER_COUNT; i++) {
+            valid[i] = false;
+        }
+    }
+
+    void beginFrame() {
+        frameDraws = 0;
+    }
+
+    void endFrame() {}
+
+    long long getQuadsBuilt() const {
+        return quadsBuilt;
+    }
+
+    int getFrameDrawCalls() const {
+        return frameDraws;
+    }
+};
+
+#endif
@@ -0,0 +1,569 @@
+#ifndef TETRIS_REPLAY_H
+#define TETRIS_REPLAY_H
+
+// Input recording and replay. A TetrisCore game is fully determined by the
+// seed and piece randomizer the core was built with and the inputs applied
+// between its ticks, so a recording holds only those: the seed and
+// randomizer, then one event per input
+// stamped with the number of ticks that had run when it was applied.
+//
+// Replaying builds a fresh core from the seed and, before each tick, applies
+// the inputs recorded at that tick. The window does this in real time and
+// tetrisHeadless.cpp --replay as fast as the CPU allows. The final score,
+// lines and piece count are stored too, so a replay can check that it
+// reproduced the recorded game.
+//
+// On disk the ticks are split into chunks of keyframeInterval ticks. Each
+// chunk starts with a keyframe, the full game state at its first tick, and
+// then holds that chunk's inputs as varints of tick delta << 3 | input. A
+// footer at the end of the file indexes the chunks, so ReplayFile can map
+// a file, jump straight to the keyframe before any tick and simulate at
+// most one chunk from there:
+//
+//   ReplayHeader
+//   chunk 0: ReplayKeyframe, stack rows, inputs
+//   ...
+//   chunk n - 1
+//   ReplayIndexEntry[n]
+//   ReplayFooter
+//
+// Integers are stored in host byte order.
+
+#include "tetrisCore.h"
+#include "tetrisPlacement.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+enum GameInput : uint8_t {
+    INPUT_LEFT,
+    INPUT_RIGHT,
+    INPUT_ROTATE,
+    INPUT_SOFT_DROP,
+    INPUT_HARD_DROP,
+    // A gravity step on demand, which the AI uses to lock its piece.
+    INPUT_STEP,
+    INPUT_PAUSE,
+    INPUT_RESTART,
+    INPUT_COUNT
+};
+
+const char* const GAME_INPUT_NAMES[INPUT_COUNT] = {"left", "right", "rotate", "soft drop", "hard drop", "step", "pause", "restart"};
+
+// Placement moves are the first inputs, so the AI's moves record as-is.
+static_assert(INPUT_LEFT == (int)MOVE_LEFT && INPUT_RIGHT == (int)MOVE_RIGHT &&
+              INPUT_ROTATE == (int)MOVE_ROTATE && INPUT_SOFT_DROP == (int)MOVE_SOFT_DROP &&
+              INPUT_HARD_DROP == (int)MOVE_HARD_DROP, "GameInput must extend PlacementMove");
+static_assert(INPUT_COUNT <= 8, "inputs are stored in 3 bits");
+
+template <typename Core>
+inline void applyInput(Core& core, GameInput input) {
+    switch (input) {
+        case INPUT_LEFT: core.movePiece(-1, 0); break;
+        case INPUT_RIGHT: core.movePiece(1, 0); break;
+        case INPUT_ROTATE: core.rotatePiece(); break;
+        case INPUT_SOFT_DROP: core.movePiece(0, 1); break;
+        case INPUT_HARD_DROP: core.hardDrop(); break;
+        case INPUT_STEP: core.step(); break;
+        case INPUT_PAUSE: core.togglePause(); break;
+        case INPUT_RESTART: core.restartGame(); break;
+        default: break;
+    }
+}
+
+struct InputEvent {
+    uint32_t tick;
+    GameInput input;
+};
+
+class InputRecording {
+public:
+    uint32_t seed;
+    PieceRandomizer randomizer;
+    std::vector<InputEvent> events;
+    // Ticks the game ran for; events may be stamped with this tick too.
+    uint32_t endTick;
+    int finalScore;
+    int finalLines;
+    int finalPieces;
+
+    explicit InputRecording(uint32_t seed = 0, PieceRandomizer randomizer = RANDOMIZER_UNIFORM)
+        : seed(seed), randomizer(randomizer), endTick(0), finalScore(0), finalLines(0), finalPieces(0) {}
+
+    // Ticks must not decrease from one call to the next.
+    void record(uint32_t tick, GameInput input) {
+        events.push_back(InputEvent{tick, input});
+    }
+
+    template <typename Core>
+    void finish(uint32_t tick, const Core& core) {
+        endTick = tick;
+        finalScore = core.getScore();
+        finalLines = core.getLines();
+        finalPieces = core.getPiecesPlaced();
+    }
+
+    // Writes the recording in the seekable format, simulating it to build
+    // a keyframe every keyframeInterval ticks.
+    bool save(const char* path, uint32_t keyframeInterval = 600) const;
+    bool load(const char* path);
+
+    // Whether core ended where the recorded game did.
+    bool matches(const TetrisCore& core) const {
+        return core.getScore() == finalScore && core.getLines() == finalLines && core.getPiecesPlaced() == finalPieces;
+    }
+};
+
+// Feeds a recording's inputs back into a core built from its seed.
+class ReplayPlayer {
+private:
+    const InputRecording* recording;
+    size_t nextEvent;
+
+public:
+    explicit ReplayPlayer(const InputRecording& recording) : recording(&recording), nextEvent(0) {}
+
+    // Applies every input recorded at tick. Call once per tick, before
+    // core.tick(), with ticks counting up from 0.
+    void applyInputs(TetrisCore& core, uint32_t tick) {
+        const std::vector<InputEvent>& events = recording->events;
+        while (nextEvent < events.size() && events[nextEvent].tick <= tick) {
+            applyInput(core, events[nextEvent++].input);
+        }
+    }
+
+    bool isFinished(uint32_t tick) const {
+        return tick >= recording->endTick && nextEvent == recording->events.size();
+    }
+
+    // Skips to the first input recorded at or after tick, for when the
+    // core has been moved there with ReplayFile::seek.
+    void seek(uint32_t tick) {
+        const std::vector<InputEvent>& events = recording->events;
+        nextEvent = std::lower_bound(events.begin(), events.end(), tick,
+            [](const InputEvent& event, uint32_t t) { return event.tick < t; }) - events.begin();
+    }
+};
+
+// Replays a whole recording on core, which must be freshly built from
+// recording.seed, as fast as possible. Returns whether it matched.
+inline bool replayToEnd(const InputRecording& recording, TetrisCore& core) {
+    ReplayPlayer player(recording);
+    for (uint32_t tick = 0; tick < recording.endTick; tick++) {
+        player.applyInputs(core, tick);
+        core.tick();
+    }
+    player.applyInputs(core, recording.endTick);
+    return recording.matches(core);
+}
+
+struct ReplayHeader {
+    static const uint32_t MAGIC = 0x4C505254;  // "TRPL"
+    static const uint32_t VERSION = 4;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seed;
+    uint32_t keyframeInterval;
+    uint32_t randomizer;
+};
+
+// Followed by stackRows rows of cell types, ending with the bottom row of
+// the field, two cells per byte. The rows above them are empty.
+struct ReplayKeyframe {
+    static const uint8_t GAME_OVER = 1;
+    static const uint8_t PAUSED = 2;
+    static const int ROW_BYTES = (GRID_WIDTH + 1) / 2;
+
+    uint32_t tick;
+    PieceGenerator pieces;
+    int32_t score;
+    int32_t level;
+    int32_t linesCleared;
+    int32_t piecesPlaced;
+    int32_t ticksSinceFall;
+    Tetromino currentPiece;
+    Tetromino nextPiece;
+    uint8_t flags;
+    uint8_t stackRows;
+};
+
+struct ReplayIndexEntry {
+    // File offset of the chunk's keyframe.
+    uint32_t offset;
+    // Inputs recorded before the chunk.
+    uint32_t firstEvent;
+};
+
+struct ReplayFooter {
+    uint32_t indexOffset;
+    uint32_t chunkCount;
+    uint32_t eventCount;
+    uint32_t endTick;
+    int32_t finalScore;
+    int32_t finalLines;
+    int32_t finalPieces;
+    uint32_t magic;
+};
+
+template <typename T>
+void appendBytes(std::vector<uint8_t>& out, const T& value) {
+    const uint8_t* bytes = (const uint8_t*)&value;
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+inline void appendVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// Reads a varint at pos and advances past it. Returns false if it runs
+// past end or is longer than five bytes.
+inline bool readVarint(const uint8_t*& pos, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && pos < end; shift += 7) {
+        uint8_t byte = *pos++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+inline void appendKeyframe(std::vector<uint8_t>& out, const TetrisState& state, uint32_t tick) {
+    int stackRows = 0;
+    for (int y = 0; y < GRID_HEIGHT && !stackRows; y++) {
+        for (int x = 0; x < GRID_WIDTH; x++) {
+            if (state.cells[y][x]) {
+                stackRows = GRID_HEIGHT - y;
+                break;
+            }
+        }
+    }
+
+    // Value-initialised so the padding written out is zero too.
+    ReplayKeyframe keyframe = ReplayKeyframe();
+    keyframe.tick = tick;
+    keyframe.pieces = state.pieces;
+    keyframe.score = state.score;
+    keyframe.level = state.level;
+    keyframe.linesCleared = state.linesCleared;
+    keyframe.piecesPlaced = state.piecesPlaced;
+    keyframe.ticksSinceFall = state.ticksSinceFall;
+    keyframe.currentPiece = state.currentPiece;
+    keyframe.nextPiece = state.nextPiece;
+    keyframe.flags = (state.gameOver ? ReplayKeyframe::GAME_OVER : 0) | (state.gamePaused ? ReplayKeyframe::PAUSED : 0);
+    keyframe.stackRows = (uint8_t)stackRows;
+    appendBytes(out, keyframe);
+
+    for (int y = GRID_HEIGHT - stackRows; y < GRID_HEIGHT; y++) {
+        for (int x = 0; x < GRID_WIDTH; x += 2) {
+            uint8_t high = x + 1 < GRID_WIDTH ? state.cells[y][x + 1] : 0;
+            out.push_back((uint8_t)(state.cells[y][x] | high << 4));
+        }
+    }
+}
+
+inline bool InputRecording::save(const char* path, uint32_t keyframeInterval) const {
+    if (keyframeInterval < 1) keyframeInterval = 1;
+    std::vector<uint8_t> out;
+    ReplayHeader header = {ReplayHeader::MAGIC, ReplayHeader::VERSION, seed, keyframeInterval, randomizer};
+    appendBytes(out, header);
+
+    std::vector<ReplayIndexEntry> index;
+    TetrisCore core(seed, randomizer);
+    TetrisState state;
+    size_t next = 0;
+    uint32_t lastTick = 0;
+    for (uint32_t tick = 0;; tick++) {
+        if (tick % keyframeInterval == 0) {
+            index.push_back(ReplayIndexEntry{(uint32_t)out.size(), (uint32_t)next});
+            core.saveState(state);
+            appendKeyframe(out, state, tick);
+            lastTick = tick;
+        }
+        while (next < events.size() && events[next].tick <= tick) {
+            appendVarint(out, (tick - lastTick) << 3 | events[next].input);
+            applyInput(core, events[next].input);
+            lastTick = tick;
+            next++;
+        }
+        if (tick >= endTick) break;
+        core.tick();
+    }
+
+    ReplayFooter footer = {(uint32_t)out.size(), (uint32_t)index.size(), (uint32_t)next, endTick,
+                           finalScore, finalLines, finalPieces, ReplayHeader::MAGIC};
+    for (const ReplayIndexEntry& entry : index) {
+        appendBytes(out, entry);
+    }
+    appendBytes(out, footer);
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    return fclose(file) == 0 && ok;
+}
+
+// Read-only view of a replay file, memory-mapped where the platform allows.
+// Nothing is decoded up front: seek() reads one index entry, one keyframe
+// and the inputs of one chunk.
+class ReplayFile {
+private:
+    const uint8_t* data;
+    size_t size;
+    bool mapped;
+    std::vector<uint8_t> buffer;
+    ReplayHeader header;
+    ReplayFooter footer;
+
+    ReplayFile(const ReplayFile&) = delete;
+    ReplayFile& operator=(const ReplayFile&) = delete;
+
+    template <typename T>
+    T readAt(size_t offset) const {
+        T value;
+        memcpy(&value, data + offset, sizeof(T));
+        return value;
+    }
+
+    // A known shape whose cells are inside the field's columns, above its
+    // floor and no higher than the rows the board keeps above it.
+    static bool validPiece(const Tetromino& piece) {
+        if (piece.type < 0 || piece.type >= PIECE_TYPES || piece.rotation < 0 || piece.rotation >= PIECE_ROTATIONS) {
+            return false;
+        }
+        const PieceRotation& shape = piece.shape();
+        return piece.x + shape.minX >= 0 && piece.x + shape.maxX < GRID_WIDTH && piece.y + shape.minY >= -BOARD_TOP &&
+               piece.y + shape.maxY < GRID_HEIGHT;
+    }
+
+    // Everything in a keyframe besides the cells that the core would use
+    // without checking: the level divides the fall speed and the generator
+    // indexes its bag.
+    static bool validKeyframe(const ReplayKeyframe& keyframe) {
+        return validPiece(keyframe.currentPiece) && validPiece(keyframe.nextPiece) && keyframe.linesCleared >= 0 &&
+               keyframe.level >= 1 && keyframe.level <= keyframe.linesCleared / 10 + 1 &&
+               keyframe.ticksSinceFall >= 0 && keyframe.ticksSinceFall <= UINT8_MAX && keyframe.pieces.isValid();
+    }
+
+    size_t chunkEnd(uint32_t chunk) const {
+        return chunk + 1 < footer.chunkCount ? getIndexEntry(chunk + 1).offset : footer.indexOffset;
+    }
+
+    bool validate() {
+        if (size < sizeof(ReplayHeader) + sizeof(ReplayFooter)) return false;
+        header = readAt<ReplayHeader>(0);
+        footer = readAt<ReplayFooter>(size - sizeof(ReplayFooter));
+        if (header.magic != ReplayHeader::MAGIC || header.version != ReplayHeader::VERSION ||
+            footer.magic != ReplayHeader::MAGIC || header.keyframeInterval < 1 ||
+            header.randomizer >= RANDOMIZER_COUNT) return false;
+        if (footer.chunkCount != footer.endTick / header.keyframeInterval + 1) return false;
+        if ((uint64_t)footer.indexOffset + (uint64_t)footer.chunkCount * sizeof(ReplayIndexEntry) !=
+            size - sizeof(ReplayFooter)) return false;
+
+        size_t previous = sizeof(ReplayHeader);
+        for (uint32_t chunk = 0; chunk < footer.chunkCount; chunk++) {
+            ReplayIndexEntry entry = getIndexEntry(chunk);
+            if (entry.offset < previous || entry.offset + sizeof(ReplayKeyframe) > footer.indexOffset) return false;
+            previous = entry.offset + sizeof(ReplayKeyframe);
+        }
+        return true;
+    }
+
+public:
+    ReplayFile() : data(NULL), size(0), mapped(false) {}
+
+    ~ReplayFile() {
+        close();
+    }
+
+    bool open(const char* path) {
+        close();
+#ifndef _WIN32
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                data = (const uint8_t*)view;
+                size = (size_t)info.st_size;
+                mapped = true;
+            }
+        }
+        ::close(fd);
+        if (!mapped) return false;
+#else
+        FILE* file = fopen(path, "rb");
+        if (!file) return false;
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        buffer.resize(length > 0 ? (size_t)length : 0);
+        bool ok = fread(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        fclose(file);
+        if (!ok) return false;
+        data = buffer.data();
+        size = buffer.size();
+#endif
+        if (!validate()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (mapped) munmap((void*)data, size);
+#endif
+        buffer.clear();
+        data = NULL;
+        size = 0;
+        mapped = false;
+    }
+
+    bool isOpen() const {
+        return data != NULL;
+    }
+
+    // Bytes the file takes on disk.
+    size_t getSize() const {
+        return size;
+    }
+
+    uint32_t getSeed() const {
+        return header.seed;
+    }
+
+    uint32_t getKeyframeInterval() const {
+        return header.keyframeInterval;
+    }
+
+    uint32_t getChunkCount() const {
+        return footer.chunkCount;
+    }
+
+    uint32_t getEventCount() const {
+        return footer.eventCount;
+    }
+
+    uint32_t getEndTick() const {
+        return footer.endTick;
+    }
+
+    const ReplayFooter& getFooter() const {
+        return footer;
+    }
+
+    ReplayIndexEntry getIndexEntry(uint32_t chunk) const {
+        return readAt<ReplayIndexEntry>(footer.indexOffset + chunk * sizeof(ReplayIndexEntry));
+    }
+
+    // Decodes the keyframe that starts chunk. Returns false if the file is
+    // corrupt.
+    bool readKeyframe(uint32_t chunk, TetrisState& state) const {
+        size_t offset = getIndexEntry(chunk).offset;
+        ReplayKeyframe keyframe = readAt<ReplayKeyframe>(offset);
+        offset += sizeof(ReplayKeyframe);
+        if (keyframe.stackRows > GRID_HEIGHT ||
+            offset + keyframe.stackRows * ReplayKeyframe::ROW_BYTES > chunkEnd(chunk)) return false;
+        if (!validKeyframe(keyframe)) return false;
+
+        memset(state.cells, 0, sizeof(state.cells));
+        for (int y = GRID_HEIGHT - keyframe.stackRows; y < GRID_HEIGHT; y++) {
+            for (int x = 0; x < GRID_WIDTH; x += 2) {
+                uint8_t pair = data[offset++];
+                // A cell is 0 for empty or a piece type plus one.
+                if ((pair & 0xf) > PIECE_TYPES || (x + 1 < GRID_WIDTH && (pair >> 4) > PIECE_TYPES)) return false;
+                state.cells[y][x] = pair & 0xf;
+                if (x + 1 < GRID_WIDTH) state.cells[y][x + 1] = pair >> 4;
+            }
+        }
+        state.currentPiece = keyframe.currentPiece;
+        state.nextPiece = keyframe.nextPiece;
+        state.score = keyframe.score;
+        state.level = keyframe.level;
+        state.linesCleared = keyframe.linesCleared;
+        state.piecesPlaced = keyframe.piecesPlaced;
+        state.ticksSinceFall = keyframe.ticksSinceFall;
+        state.pieces = keyframe.pieces;
+        state.gameOver = (keyframe.flags & ReplayKeyframe::GAME_OVER) != 0;
+        state.gamePaused = (keyframe.flags & ReplayKeyframe::PAUSED) != 0;
+        return true;
+    }
+
+    // Appends the inputs recorded in chunk to out. Returns false if the
+    // file is corrupt.
+    bool readEvents(uint32_t chunk, std::vector<InputEvent>& out) const {
+        size_t offset = getIndexEntry(chunk).offset;
+        offset += sizeof(ReplayKeyframe) + readAt<ReplayKeyframe>(offset).stackRows * ReplayKeyframe::ROW_BYTES;
+        const uint8_t* end = data + chunkEnd(chunk);
+        const uint8_t* pos = data + offset;
+        if (pos > end) return false;
+
+        uint32_t tick = chunk * header.keyframeInterval;
+        while (pos < end) {
+            uint32_t value;
+            if (!readVarint(pos, end, value)) return false;
+            tick += value >> 3;
+            out.push_back(InputEvent{tick, (GameInput)(value & 7)});
+        }
+        return true;
+    }
+
+    // Puts core in the state it had at the start of tick, before that
+    // tick's inputs: loads the keyframe at or before tick and simulates the
+    // rest of the way.
+    bool seek(TetrisCore& core, uint32_t tick) const {
+        if (tick > footer.endTick) tick = footer.endTick;
+        uint32_t chunk = tick / header.keyframeInterval;
+        TetrisState state;
+        std::vector<InputEvent> events;
+        if (!readKeyframe(chunk, state) || !readEvents(chunk, events)) return false;
+
+        core.loadState(state);
+        size_t next = 0;
+        for (uint32_t t = chunk * header.keyframeInterval; t < tick; t++) {
+            while (next < events.size() && events[next].tick <= t) {
+                applyInput(core, events[next++].input);
+            }
+            core.tick();
+        }
+        return true;
+    }
+
+    // Decodes every input and the recorded result into recording.
+    bool readRecording(InputRecording& recording) const {
+        recording.seed = header.seed;
+        recording.randomizer = (PieceRandomizer)header.randomizer;
+        recording.endTick = footer.endTick;
+        recording.finalScore = footer.finalScore;
+        recording.finalLines = footer.finalLines;
+        recording.finalPieces = footer.finalPieces;
+        recording.events.clear();
+        recording.events.reserve(footer.eventCount);
+        for (uint32_t chunk = 0; chunk < footer.chunkCount; chunk++) {
+            if (!readEvents(chunk, recording.events)) return false;
+        }
+        return recording.events.size() == footer.eventCount;
+    }
+};
+
+inline bool InputRecording::load(const char* path) {
+    ReplayFile file;
+    return file.open(path) && file.readRecording(*this);
+}
+
+#endif
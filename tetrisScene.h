@@ -0,0 +1,407 @@
+#ifndef TETRIS_SCENE_H
+#define TETRIS_SCENE_H
+
+// The layout of a frame: where the playfield, side panel, buttons, text and
+// help overlay go. TetrisScene draws it through a canvas, so the window's
+// OpenGL renderer and the software rasterizer in tetrisRaster.h produce the
+// same picture from the same code.
+//
+// A canvas provides:
+//   rect(x, y, w, h, color, brightness)  a filled rectangle
+//   text(text, x, y, color, pixelSize)   a string in the 5x7 font
+//   flush()                              finishes queued rectangles
+//   drawBoard(core)                      the playfield's locked cells
+//   beginLayer(layer) / endLayer(layer)  re-renders a cached layer, if stale
+//   composite(layer, x, y, w, h)         copies part of a layer to the frame
+//   invalidate(layer)
+//   beginFrame() / endFrame()
+// Everything is in window pixels with the origin at the top left.
+//
+// The scene is drawn from any BasicTetrisCore: the playfield shows the
+// core's VISIBLE_HEIGHT rows, and its border follows the board's width.
+
+#include "tetrisCore.h"
+#include "tetrisTrace.h"
+#include <ostream>
+#include <string>
+
+const int WINDOW_WIDTH = 1000;
+const int WINDOW_HEIGHT = 800;
+const float BLOCK_SIZE = 30.0f;
+const float GRID_OFFSET_X = 50.0f;
+const float GRID_OFFSET_Y = 50.0f;
+const float BORDER_WIDTH = 3.0f;
+
+const float GRID_BACKGROUND_COLOR[3] = {0.2f, 0.2f, 0.3f};
+const float GRID_BACKGROUND_BRIGHTNESS = 0.3f;
+// What a layer is cleared to, and what shows between the board's cells.
+const float CLEAR_COLOR[3] = {0.05f, 0.05f, 0.1f};
+
+enum Layer {
+    LAYER_BOARD,
+    LAYER_PANEL,
+    LAYER_HELP,
+    LAYER_COUNT
+};
+
+struct SceneButton {
+    float x, y, w, h;
+    bool hovered;
+
+    bool contains(double px, double py) const {
+        return px >= x && px <= x + w && py >= y && py <= y + h;
+    }
+};
+
+// Window state the frame depends on besides the game itself.
+struct SceneUi {
+    bool showHelp = false;
+    SceneButton restartButton = {WINDOW_WIDTH - 180, 400, 120, 40, false};
+    SceneButton helpButton = {WINDOW_WIDTH - 180, 500, 120, 40, false};
+    SceneButton closeHelpButton = {WINDOW_WIDTH / 2 - 60, WINDOW_HEIGHT / 2 + 150, 120, 40, false};
+};
+
+// How far the falling piece is toward its next gravity step, counting alpha,
+// the part of a tick since the last one ran, so that it glides down at any
+// frame rate instead of jumping a row per step. A piece resting on the stack
+// stays put.
+template <typename Core>
+inline float fallProgress(const Core& core, double alpha) {
+    const Tetromino& piece = core.getCurrentPiece();
+    if (core.getBoard().collides(piece.shape().rows, piece.x, piece.y + 1)) return 0.0f;
+    float progress = (float)((core.getTicksSinceFall() + alpha) / core.getFallTicks());
+    return progress < 1.0f ? progress : 1.0f;
+}
+
+template <typename Canvas>
+class TetrisScene {
+private:
+    Canvas& canvas;
+    // The core, board version and game state the cached layers were drawn
+    // from. The panel shows PAUSED and GAME OVER, which change nothing on
+    // the board.
+    const void* layerCore;
+    unsigned int layerBoardVersion;
+    bool layerPaused;
+    bool layerGameOver;
+
+public:
+    explicit TetrisScene(Canvas& canvas)
+        : canvas(canvas), layerCore(NULL), layerBoardVersion(0), layerPaused(false), layerGameOver(false) {}
+
+    void drawText(const std::string& text, float x, float y, const float color[3], float pixelSize = 3.0f) {
+        TRACE_ZONE("drawText");
+        canvas.text(text, x, y, color, pixelSize);
+    }
+
+    void drawButton(const SceneButton& button, const std::string& text, bool pressed = false) {
+        TRACE_ZONE("drawButton");
+        float bgColor[3];
+        if (text == "RESTART") {
+            if (pressed) {
+                bgColor[0] = 0.1f; bgColor[1] = 0.4f; bgColor[2] = 0.1f;
+            } else if (button.hovered) {
+                bgColor[0] = 0.2f; bgColor[1] = 0.8f; bgColor[2] = 0.2f;
+            } else {
+                bgColor[0] = 0.1f; bgColor[1] = 0.6f; bgColor[2] = 0.1f;
+            }
+        } else if (text == "HELP") {
+            if (pressed) {
+                bgColor[0] = 0.6f; bgColor[1] = 0.6f; bgColor[2] = 0.0f;
+            } else if (button.hovered) {
+                bgColor[0] = 1.0f; bgColor[1] = 1.0f; bgColor[2] = 0.3f;
+            } else {
+                bgColor[0] = 0.8f; bgColor[1] = 0.8f; bgColor[2] = 0.0f;
+            }
+        } else {
+            if (pressed) {
+                bgColor[0] = 0.2f; bgColor[1] = 0.6f; bgColor[2] = 0.2f;
+            } else if (button.hovered) {
+                bgColor[0] = 0.3f; bgColor[1] = 0.7f; bgColor[2] = 0.3f;
+            } else {
+                bgColor[0] = 0.4f; bgColor[1] = 0.4f; bgColor[2] = 0.4f;
+            }
+        }
+
+        canvas.rect(button.x, button.y, button.w, button.h, bgColor);
+
+        float textColor[3] = {1.0f, 1.0f, 1.0f};
+        float textX = button.x + (button.w - text.length() * 6 * 2.5f) / 2;
+        float textY = button.y + (button.h - 7 * 2.5f) / 2;
+        drawText(text, textX, textY, textColor, 2.5f);
+    }
+
+    void drawBorder(int columns, int rows) {
+        TRACE_ZONE("drawBorder");
+        float borderColor[3] = {0.8f, 0.8f, 0.8f};
+
+        float gridAreaX = GRID_OFFSET_X;
+        float gridAreaY = GRID_OFFSET_Y;
+        float gridAreaW = columns * BLOCK_SIZE;
+        float gridAreaH = rows * BLOCK_SIZE;
+
+        canvas.rect(gridAreaX - BORDER_WIDTH, gridAreaY - BORDER_WIDTH, gridAreaW + 2 * BORDER_WIDTH, BORDER_WIDTH, borderColor);
+        canvas.rect(gridAreaX - BORDER_WIDTH, gridAreaY + gridAreaH, gridAreaW + 2 * BORDER_WIDTH, BORDER_WIDTH, borderColor);
+        canvas.rect(gridAreaX - BORDER_WIDTH, gridAreaY, BORDER_WIDTH, gridAreaH, borderColor);
+        canvas.rect(gridAreaX + gridAreaW, gridAreaY, BORDER_WIDTH, gridAreaH, borderColor);
+    }
+
+    void drawHelpOverlay(const SceneUi& ui) {
+        TRACE_ZONE("drawHelpOverlay");
+        if (!ui.showHelp) return;
+
+        float overlayColor[3] = {0.0f, 0.0f, 0.0f};
+        canvas.rect(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, overlayColor, 0.7f);
+
+        float panelColor[3] = {0.2f, 0.2f, 0.3f};
+        float panelX = WINDOW_WIDTH / 2 - 200;
+        float panelY = WINDOW_HEIGHT / 2 - 200;
+        float panelW = 400;
+        float panelH = 400;
+
+        canvas.rect(panelX, panelY, panelW, panelH, panelColor);
+
+        float textColor[3] = {1.0f, 1.0f, 1.0f};
+        float titleColor[3] = {0.0f, 1.0f, 1.0f};
+        float textX = panelX + 20;
+        float textY = panelY + 20;
+
+        drawText("HOW TO PLAY TETRIS", textX, textY, titleColor, 2.5f);
+
+        drawText("CONTROLS:", textX, textY + 40, textColor, 2.0f);
+        drawText("A/D OR LEFT/RIGHT - MOVE", textX, textY + 60, textColor, 1.8f);
+        drawText("W OR UP - ROTATE PIECE", textX, textY + 80, textColor, 1.8f);
+        drawText("S OR DOWN - SOFT DROP", textX, textY + 100, textColor, 1.8f);
+        drawText("SPACE - HARD DROP", textX, textY + 120, textColor, 1.8f);
+        drawText("P - PAUSE/RESUME", textX, textY + 140, textColor, 1.8f);
+        drawText("R - RESTART GAME", textX, textY + 160, textColor, 1.8f);
+
+        drawText("OBJECTIVE:", textX, textY + 190, textColor, 2.0f);
+        drawText("FILL COMPLETE ROWS TO", textX, textY + 210, textColor, 1.8f);
+        drawText("CLEAR THEM AND SCORE", textX, textY + 230, textColor, 1.8f);
+        drawText("POINTS", textX, textY + 250, textColor, 1.8f);
+
+        drawText("SCORING:", textX, textY + 280, textColor, 2.0f);
+        drawText("1 LINE = 40 X LEVEL", textX, textY + 300, textColor, 1.8f);
+        drawText("2 LINES = 100 X LEVEL", textX, textY + 320, textColor, 1.8f);
+        drawText("3 LINES = 300 X LEVEL", textX, textY + 340, textColor, 1.8f);
+        drawText("4 LINES = 1200 X LEVEL", textX, textY + 360, textColor, 1.8f);
+
+        float closeColor[3] = {1.0f, 1.0f, 0.0f};
+        drawText("CLICK CLOSE BUTTON TO RETURN", textX, textY + 380, closeColor, 1.5f);
+
+        drawButton(ui.closeHelpButton, "CLOSE");
+    }
+
+    void drawBlock(float x, float y, const float color[3], float brightness = 1.0f) {
+        TRACE_ZONE("drawBlock");
+        canvas.rect(x * BLOCK_SIZE + GRID_OFFSET_X, y * BLOCK_SIZE + GRID_OFFSET_Y,
+                    BLOCK_SIZE - 1, BLOCK_SIZE - 1, color, brightness);
+    }
+
+    // Also moves the buttons to where the panel puts them.
+    template <typename Core>
+    void drawPanel(const Core& core, SceneUi& ui) {
+        TRACE_ZONE("drawPanel");
+        drawBorder(Core::WIDTH, Core::VISIBLE_HEIGHT);
+
+        float panelColor[3] = {0.15f, 0.15f, 0.2f};
+        float panelX = WINDOW_WIDTH - 220;
+        float panelY = GRID_OFFSET_Y;
+        float panelW = 200;
+        float panelH = Core::VISIBLE_HEIGHT * BLOCK_SIZE;
+
+        canvas.rect(panelX, panelY, panelW, panelH, panelColor);
+
+        float textColor[3] = {1.0f, 1.0f, 1.0f};
+        float uiX = panelX + 10;
+        float uiY = panelY + 20;
+
+        drawText("SCORE:", uiX, uiY, textColor, 2.5f);
+        drawText(std::to_string(core.getScore()), uiX, uiY + 25, textColor, 2.5f);
+
+        drawText("LEVEL:", uiX, uiY + 65, textColor, 2.5f);
+        drawText(std::to_string(core.getLevel()), uiX, uiY + 90, textColor, 2.5f);
+
+        drawText("LINES:", uiX, uiY + 130, textColor, 2.5f);
+        drawText(std::to_string(core.getLines()), uiX, uiY + 155, textColor, 2.5f);
+
+        drawText("NEXT:", uiX, uiY + 195, textColor, 2.5f);
+        float previewX = (panelX + 20 - GRID_OFFSET_X) / BLOCK_SIZE;
+        float previewY = (uiY + 220 - GRID_OFFSET_Y) / BLOCK_SIZE;
+        const Tetromino& nextPiece = core.getNextPiece();
+        for (const CellOffset& cell : nextPiece.shape().cells) {
+            drawBlock(previewX + cell.x, previewY + cell.y, nextPiece.color(), 0.8f);
+        }
+
+        ui.restartButton.x = panelX + 40;
+        ui.restartButton.y = 370;
+        drawButton(ui.restartButton, "RESTART");
+
+        ui.helpButton.x = panelX + 40;
+        ui.helpButton.y = 470;
+        drawButton(ui.helpButton, "HELP");
+
+        if (core.isPaused()) {
+            float pauseColor[3] = {1.0f, 1.0f, 0.0f};
+            drawText("PAUSED", uiX, uiY + 480, pauseColor, 3.0f);
+        }
+
+        if (core.isGameOver()) {
+            float gameOverColor[3] = {1.0f, 0.0f, 0.0f};
+            drawText("GAME", uiX, uiY + 480, gameOverColor, 3.0f);
+            drawText("OVER", uiX, uiY + 510, gameOverColor, 3.0f);
+        }
+    }
+
+    // Re-renders only the layers whose contents changed, composites them and
+    // draws the ghost and the falling piece on top, the piece fall rows below
+    // where it is. The help overlay is opaque and covers the whole window,
+    // so nothing else is composited while it is open.
+    template <typename Core>
+    void render(const Core& core, SceneUi& ui, float fall = 0.0f) {
+        TRACE_ZONE("render");
+        canvas.beginFrame();
+
+        if (layerCore != &core || core.getBoardVersion() != layerBoardVersion) {
+            layerCore = &core;
+            layerBoardVersion = core.getBoardVersion();
+            canvas.invalidate(LAYER_BOARD);
+            canvas.invalidate(LAYER_PANEL);
+        }
+        if (core.isPaused() != layerPaused || core.isGameOver() != layerGameOver) {
+            layerPaused = core.isPaused();
+            layerGameOver = core.isGameOver();
+            canvas.invalidate(LAYER_PANEL);
+        }
+
+        if (ui.showHelp) {
+            if (canvas.beginLayer(LAYER_HELP)) {
+                drawHelpOverlay(ui);
+                canvas.flush();
+                canvas.endLayer(LAYER_HELP);
+            }
+            canvas.composite(LAYER_HELP, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+            canvas.endFrame();
+            return;
+        }
+
+        if (canvas.beginLayer(LAYER_PANEL)) {
+            drawPanel(core, ui);
+            canvas.flush();
+            canvas.endLayer(LAYER_PANEL);
+        }
+        if (canvas.beginLayer(LAYER_BOARD)) {
+            canvas.drawBoard(core);
+            canvas.endLayer(LAYER_BOARD);
+        }
+
+        canvas.composite(LAYER_PANEL, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+        canvas.composite(LAYER_BOARD, GRID_OFFSET_X, GRID_OFFSET_Y,
+                         Core::WIDTH * BLOCK_SIZE, Core::VISIBLE_HEIGHT * BLOCK_SIZE);
+
+        if (!core.isGameOver() && !core.isPaused()) {
+            const Tetromino& currentPiece = core.getCurrentPiece();
+            // The ghost shows where a hard drop would land; once the piece
+            // is there it covers it.
+            Tetromino ghost = core.getGhostPiece();
+            if (ghost.y != currentPiece.y) {
+                for (const CellOffset& cell : ghost.shape().cells) {
+                    int row = ghost.y + cell.y - Core::HIDDEN_ROWS;
+                    if (row < 0) continue;
+                    drawBlock(ghost.x + cell.x, row, ghost.color(), 0.3f);
+                }
+            }
+            for (const CellOffset& cell : currentPiece.shape().cells) {
+                int row = currentPiece.y + cell.y - Core::HIDDEN_ROWS;
+                // Cells in a hidden buffer are not shown.
+                if (Core::HIDDEN_ROWS > 0 && row < 0) continue;
+                drawBlock(currentPiece.x + cell.x, row + fall, currentPiece.color());
+            }
+            canvas.flush();
+        }
+        canvas.endFrame();
+    }
+};
+
+// Renders frames idle frames in each state the window can sit in, playing,
+// paused, with the help open and after game over, with only the piece's fall
+// changing, and checks that no layer is re-rendered after the first frame of
+// each; a piece locking must still re-render the board once. The canvas also
+// needs getLayerRenderCount(layer). Reports each state to out and returns the
+// number of failed checks.
+template <typename Core, typename Canvas>
+int checkIdleFrames(Canvas& canvas, int frames, std::ostream& out) {
+    TetrisScene<Canvas> scene(canvas);
+    SceneUi ui;
+    Core core;
+    auto layerRenders = [&]() {
+        int renders = 0;
+        for (int layer = 0; layer < LAYER_COUNT; layer++) {
+            renders += canvas.getLayerRenderCount((Layer)layer);
+        }
+        return renders;
+    };
+    auto idle = [&](const char* state) {
+        scene.render(core, ui);
+        int before = layerRenders();
+        for (int i = 0; i < frames; i++) {
+            scene.render(core, ui, fallProgress(core, (double)i / frames));
+        }
+        int renders = layerRenders() - before;
+        out << state << ": " << renders << " layer renders in " << frames << " idle frames" << std::endl;
+        return renders == 0 ? 0 : 1;
+    };
+
+    int failures = idle("playing");
+    int boardRenders = canvas.getLayerRenderCount(LAYER_BOARD);
+    core.hardDrop();
+    core.step();
+    scene.render(core, ui);
+    boardRenders = canvas.getLayerRenderCount(LAYER_BOARD) - boardRenders;
+    out << "locked: " << boardRenders << " board renders" << std::endl;
+    if (boardRenders != 1) failures++;
+
+    core.togglePause();
+    failures += idle("paused");
+    core.togglePause();
+    ui.showHelp = true;
+    failures += idle("help");
+    ui.showHelp = false;
+    while (!core.isGameOver()) {
+        core.hardDrop();
+        core.step();
+    }
+    failures += idle("game over");
+    return failures;
+}
+
+// Draw calls a canvas issues for a frame that re-renders every layer of a
+// new game, and for an idle frame after it, which only composites them and
+// draws the falling piece.
+struct FrameDrawCalls {
+    int fullFrame;
+    int idleFrame;
+};
+
+// Checks a canvas issues exactly expected's draw calls for a full redraw and
+// for an idle frame while playing. The canvas needs getFrameDrawCalls().
+// Reports both to out and returns the number of failed checks.
+template <typename Core, typename Canvas>
+int checkFrameDrawCalls(Canvas& canvas, const FrameDrawCalls& expected, std::ostream& out) {
+    TetrisScene<Canvas> scene(canvas);
+    SceneUi ui;
+    Core core;
+    for (int layer = 0; layer < LAYER_COUNT; layer++) {
+        canvas.invalidate((Layer)layer);
+    }
+    scene.render(core, ui);
+    int fullFrame = canvas.getFrameDrawCalls();
+    scene.render(core, ui, 0.5f);
+    int idleFrame = canvas.getFrameDrawCalls();
+    out << "full frame: " << fullFrame << " draw calls, expected " << expected.fullFrame << std::endl;
+    out << "idle frame: " << idleFrame << " draw calls, expected " << expected.idleFrame << std::endl;
+    return (fullFrame != expected.fullFrame) + (idleFrame != expected.idleFrame);
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef TETRIS_SNAPSHOT_H
+#define TETRIS_SNAPSHOT_H
+
+// Hands the newest of a stream of snapshots from one thread to another
+// without either waiting. The window's simulation thread writes one after
+// every batch of ticks and the render thread draws whichever is newest when
+// it starts a frame; a frame that takes longer than a tick just skips the
+// snapshots it missed, and a slow buffer swap never holds up a tick.
+//
+// TripleBuffer keeps three copies of T. The writer owns one, the reader owns
+// one, and the third is the latest finished snapshot. publish() swaps the
+// writer's copy with the third and marks it fresh; acquire() swaps the
+// reader's copy with it if it is fresh. Both swaps are a single atomic
+// exchange of the index, so a copy is only ever touched by one thread at a
+// time and neither side blocks.
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T>
+class TripleBuffer {
+private:
+    static const uint8_t INDEX = 3;
+    // Set on the shared index when it holds a snapshot the reader has not
+    // taken yet.
+    static const uint8_t FRESH = 4;
+
+    T buffers[3];
+    std::atomic<uint8_t> shared;
+    uint8_t writing;
+    uint8_t reading;
+
+public:
+    TripleBuffer() : shared(1), writing(2), reading(0) {}
+
+    // The writer's copy, to fill in before publish().
+    T& back() {
+        return buffers[writing];
+    }
+
+    void publish() {
+        writing = shared.exchange((uint8_t)(writing | FRESH), std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Takes the latest published snapshot, if there is one newer than
+    // front(). Returns whether there was.
+    bool acquire() {
+        if (!(shared.load(std::memory_order_relaxed) & FRESH)) return false;
+        reading = shared.exchange(reading, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // The reader's copy, the snapshot last acquired.
+    const T& front() const {
+        return buffers[reading];
+    }
+};
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef TETRIS_TRACE_H
+#define TETRIS_TRACE_H
+
+// Scoped-zone tracing. TRACE_ZONE("name") records the start and end time of
+// the enclosing scope into a ring buffer owned by the calling thread, and
+// Tracer::writeChromeTrace dumps every ring as Chrome trace-event JSON that
+// chrome://tracing and Perfetto can open.
+//
+// While tracing is off a zone costs one relaxed atomic load and a branch.
+// Defining TETRIS_NO_TRACE compiles zones out entirely. Rings keep the most
+// recent TraceRing::CAPACITY zones per thread and overwrite older ones.
+//
+// TRACE_COUNT(counter) bumps one of the calling thread's TraceCounters, so
+// the objects doing the work need not carry counts of it. They run whether
+// or not tracing is on, and TETRIS_NO_TRACE compiles them out too.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Written only by its owning thread; readers copy it without locking and
+// drop any slot the writer may have reused while they were reading.
+class TraceRing {
+public:
+    static const uint64_t CAPACITY = 1 << 17;
+
+private:
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<uint64_t> written;
+    int threadId;
+    std::string threadName;
+
+public:
+    explicit TraceRing(int id) : events(new TraceEvent[CAPACITY]), written(0), threadId(id) {}
+
+    void push(const char* name, uint64_t start, uint64_t end) {
+        uint64_t n = written.load(std::memory_order_relaxed);
+        TraceEvent& event = events[n & (CAPACITY - 1)];
+        event.name = name;
+        event.start = start;
+        event.end = end;
+        written.store(n + 1, std::memory_order_release);
+    }
+
+    void snapshot(std::vector<TraceEvent>& out) const {
+        uint64_t end = written.load(std::memory_order_acquire);
+        uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+        size_t first = out.size();
+        for (uint64_t i = begin; i < end; i++) {
+            out.push_back(events[i & (CAPACITY - 1)]);
+        }
+        // The copies above must be done before written is read again.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = written.load(std::memory_order_relaxed);
+        // The writer may also be filling the slot of event after, which
+        // holds event after - CAPACITY, so that one is dropped too.
+        uint64_t overwritten = after + 1 > CAPACITY ? after + 1 - CAPACITY : 0;
+        if (overwritten > begin) {
+            size_t drop = (size_t)std::min<uint64_t>(overwritten - begin, end - begin);
+            out.erase(out.begin() + first, out.begin() + first + drop);
+        }
+    }
+
+    int getThreadId() const {
+        return threadId;
+    }
+
+    const std::string& getThreadName() const {
+        return threadName;
+    }
+
+    void setThreadName(const std::string& name) {
+        threadName = name;
+    }
+};
+
+class Tracer {
+private:
+    static inline std::atomic<bool> enabled{false};
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;
+    std::chrono::steady_clock::time_point epoch;
+
+    Tracer() : epoch(std::chrono::steady_clock::now()) {}
+
+    static void writeEscaped(std::ostream& out, const std::string& text) {
+        for (char c : text) {
+            if (c == '"' || c == '\\') out << '\\';
+            out << c;
+        }
+    }
+
+public:
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool on) {
+        enabled.store(on, std::memory_order_relaxed);
+    }
+
+    // Nanoseconds since the tracer was created.
+    uint64_t now() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    TraceRing& threadRing() {
+        thread_local TraceRing* ring = nullptr;
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.emplace_back(new TraceRing((int)rings.size() + 1));
+            ring = rings.back().get();
+        }
+        return *ring;
+    }
+
+    void setThreadName(const std::string& name) {
+        threadRing().setThreadName(name);
+    }
+
+    bool writeChromeTrace(const std::string& path) {
+        std::ofstream out(path);
+        if (!out) return false;
+
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        std::vector<TraceEvent> events;
+        for (const auto& ring : rings) {
+            if (!ring->getThreadName().empty()) {
+                out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                    << ring->getThreadId() << ",\"args\":{\"name\":\"";
+                writeEscaped(out, ring->getThreadName());
+                out << "\"}}";
+                first = false;
+            }
+
+            events.clear();
+            ring->snapshot(events);
+            for (const TraceEvent& event : events) {
+                out << (first ? "" : ",") << "\n{\"name\":\"";
+                writeEscaped(out, event.name);
+                out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->getThreadId()
+                    << ",\"ts\":" << event.start / 1000 << "." << (event.start % 1000) / 100
+                    << ",\"dur\":" << (event.end - event.start) / 1000 << "." << ((event.end - event.start) % 1000) / 100
+                    << "}";
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+        return (bool)out;
+    }
+};
+
+// Running totals for the calling thread, wrapping at 2^32; take differences
+// between two readings on the same thread.
+struct TraceCounters {
+    uint32_t collisionChecks;
+
+    static TraceCounters& thread() {
+        thread_local TraceCounters counters = {};
+        return counters;
+    }
+};
+
+class TraceZone {
+private:
+    const char* name;
+    uint64_t start;
+
+public:
+    explicit TraceZone(const char* zoneName) : name(nullptr), start(0) {
+        if (Tracer::isEnabled()) {
+            name = zoneName;
+            start = Tracer::instance().now();
+        }
+    }
+
+    ~TraceZone() {
+        if (name) {
+            Tracer& tracer = Tracer::instance();
+            tracer.threadRing().push(name, start, tracer.now());
+        }
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+};
+
+#ifdef TETRIS_NO_TRACE
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_COUNT(counter) ((void)0)
+#else
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone_, __LINE__)(name)
+#define TRACE_COUNT(counter) ((void)++TraceCounters::thread().counter)
+#endif
+
+#endif